@@ -9,21 +9,122 @@
 //RAM consumption parameters
 #define MAX_PACKET_QUEUE_SIZE 	70
 #define MAX_ROUTING_TABLE_SIZE 	40
-#define MAX_USER_PACKET_SIZE 2
+#define MAX_USER_PACKET_SIZE 6 //A reading, or the merge state of a fusion packet (see fusion_operator.h)
 
+//Number of BCP connections a node can open at the same time, e.g. an alarm
+//tree next to the sensing tree. Every connection has its own queue and
+//routing table pools, so the RAM they take grows with this number.
+#ifndef BCP_MAX_CONNECTIONS
+#define BCP_MAX_CONNECTIONS 1
+#endif
+
+//Number of item groups tracked by the packet queue (see bcp_queue_group_*).
+//Fusion uses one group per correlation ID.
+#ifndef BCP_QUEUE_GROUPS
+#define BCP_QUEUE_GROUPS 4
+#endif
+
+//Set to 1 when bcp_queue_array.c is the queue backend (see the Makefile). It
+//adds the ring of the array backend to struct bcp_queue.
+#ifndef BCP_QUEUE_ARRAY
+#define BCP_QUEUE_ARRAY 0
+#endif
+
+//Set to 1 when bcp_routing_table_hash.c is the routing table (see the 
+//Makefile). It adds the hash index and the packed records to struct 
+//routingtable. The index has ROUTING_TABLE_HASH_SIZE slots, a power of two 
+//larger than MAX_ROUTING_TABLE_SIZE.
+#ifndef BCP_ROUTING_TABLE_HASH
+#define BCP_ROUTING_TABLE_HASH 0
+#endif
+#define ROUTING_TABLE_HASH_SIZE 64
+
+//Number of best neighbors kept by the routing table between two searches 
+//(see bcp_routing_table_best.c)
+#define ROUTING_TABLE_TOP_K 4
+
+
+//Multiple sinks. A sink advertises a virtual backlog of the data packets it 
+//takes in per time slot (decayed with SINK_LOAD_ALPHA, in tenths) divided by 
+//SINK_LOAD_DIV, so a busy sink attracts less traffic than an idle one.
+#define SINK_LOAD_ALPHA 8
+#define SINK_LOAD_DIV   8
+
+//Binary sink output (see sink_output.h). With 0 the sink prints the delay of
+//every packet as text. The ring holds the framed records waiting for the 
+//serial port, which takes at most SINK_OUTPUT_BURST bytes per process turn.
+#ifndef SINK_OUTPUT_BINARY
+#define SINK_OUTPUT_BINARY 0
+#endif
+#define SINK_OUTPUT_BUFFER 256
+#define SINK_OUTPUT_BURST  32
+
+//Hop counts (see hop_counter.h) at or above which the sinks are taken as 
+//unreachable. Larger than the diameter of the network.
+#define HOP_COUNT_MAX 32
+
+//A neighbor not heard for this long leaves the routing table. Several beacon
+//intervals, so that a quiet neighbor is not taken as gone.
+#define ROUTING_TABLE_STALE_TIME (CLOCK_SECOND * 60)
 
 //Delays parameters
-//Time between beacons
-#define BEACON_TIME CLOCK_SECOND * 0.1
+//Time between beacons. The interval doubles up to BEACON_MAX_TIME while the 
+//queue length stays within BEACON_QUEUE_DELTA of the last advertised one.
+//Both are whole clock ticks, so that the interval can be compared with them.
+#define BEACON_TIME ((clock_time_t)(CLOCK_SECOND / 10))
+#define BEACON_MAX_TIME ((clock_time_t)(BEACON_TIME * 64))
+#define BEACON_QUEUE_DELTA 2
 //General delay before sending a packet
 #define SEND_TIME_DELAY     CLOCK_SECOND * 0.1f	// 0.05f for simulations
 //Time
 #define DELAY_TIME	    CLOCK_SECOND * 120
 #define RETX_TIME           CLOCK_SECOND * 0.14f //0.07 for simulations
+//Bounds of the retransmission timeout estimated for every neighbor
+#define RETX_MIN_TIME       CLOCK_SECOND * 0.03f
+#define RETX_MAX_TIME       CLOCK_SECOND * 2
+//Gap between two new data packets sent while the window is not full
+#define WINDOW_SEND_TIME    CLOCK_SECOND * 0.01f
+
+//Number of data packets which can wait for their ACK from the same neighbor. 
+//Their sequence numbers span at most BCP_TX_WINDOW, which fits the bitmap 
+//of the receiver (rx_mask in struct routingtable_item).
+#define BCP_TX_WINDOW 4
+#if BCP_TX_WINDOW > 8
+#error BCP_TX_WINDOW must not exceed 8
+#endif
+
+//Number of data packets which can wait for their ACK at the same time
+#define BCP_TX_INFLIGHT 8
+
+//Time during which a packet is sent again to its neighbor, from its first 
+//transmission, before it is dropped. The packet is never sent to another 
+//neighbor: this one may have received it and only the ACK been lost.
+#define BCP_TX_LIFETIME (RETX_MAX_TIME * 3)
+
+//Number of transmissions which can wait for the channel to be free
+#define BCP_TX_PENDING 6
+
+//Number of received data packets remembered to recognize the retransmissions 
+//of a neighbor whose sequence numbers are not known
+#define BCP_RECENT_SIZE 16
+//Time a received data packet, and the sequence numbers of its sender, are 
+//remembered. It outlasts BCP_TX_LIFETIME, so the retransmissions of the sender 
+//to this node come within it.
+#define BCP_RECENT_TIME (BCP_TX_LIFETIME + RETX_MAX_TIME)
 
 //Other
 #define LINK_LOSS_ALPHA   90  // Decay parameter. 90 = 90% weight of previous link loss Estimate
 #define LINK_LOSS_V       2   // V Value used to weight link losses in Lyapunov Calculation
 #define LINK_EST_ALPHA    9   // Decay parameter. 9 = 90% weight of previous rate Estimation
+#define LINK_MAX_WEIGHT   32767 // Largest weight returned by the weight estimator
+
+//Queue length a neighbor loses in the weight for every hop it is away from a 
+//shortest path to the sink (see hop_counter_gradient()). Zero weighs the 
+//neighbors by their queue differential alone (pure backpressure); a few 
+//packets keep light traffic on the shortest paths while a larger backlog 
+//still spreads heavy traffic.
+#ifndef WEIGHT_HOP_V
+#define WEIGHT_HOP_V      0
+#endif
 
 #endif
@@ -10,10 +10,14 @@
 #include "net/netstack.h"
 #include "bcp_extend.h"
 #include "bcp_queue_allocator.h"
+#include "bcp_wire.h"
 #include "hop_counter.h"
+#include "sink_output.h"
 
 #include <stddef.h>  //For offsetof
+#include <stdio.h>
 #include "lib/list.h"
+#include "lib/random.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -40,6 +44,10 @@ struct beacon_msg {
   * The queue length of the node. 
   */
   uint16_t queuelog; 
+  /**
+  * The hop count of the node (see \ref hop_counter.h). 
+  */
+  uint16_t hop_count; 
 };
 
 /**
@@ -61,30 +69,97 @@ struct beacon_request_msg {
  * \brief      A structure for acknowledgment messages.
  */
 struct ack_msg {
+  /**
+   * The sequence number of the acknowledged data packet
+   */
+  uint8_t seq;
 };
 
 
 
 static void send_beacon_request(void *ptr);
+static bool tx_beacon_request(struct bcp_conn *c);
 static void send_beacon(void *ptr);
+static bool tx_beacon(struct bcp_conn *c);
+static void schedule_beacon(struct bcp_conn *c);
+static void reset_beacon(struct bcp_conn *c);
 static bool isBeacon();
 static void prepare_packetbuf();
 static bool isBeaconRequest();
 static bool isBroadcast(rimeaddr_t * addr);
+static void sink_load_update(struct bcp_conn *c);
+static bool isRecentPacket(struct bcp_conn *c, const rimeaddr_t *from, const rimeaddr_t *origin, uint16_t origin_seq, uint8_t seq);
+static void addRecentPacket(struct bcp_conn *c, const rimeaddr_t *from, const struct bcp_queue_item *i, uint8_t seq);
+static struct bcp_inflight * find_inflight(struct bcp_conn *c, const rimeaddr_t *to, uint8_t seq);
+static struct bcp_inflight * due_inflight(struct bcp_conn *c);
+static struct bcp_inflight * free_inflight(struct bcp_conn *c);
+static void drop_inflight(struct bcp_conn *c, struct bcp_inflight *f);
+static void packet_dropped(struct bcp_conn *c);
+static bool window_open(struct bcp_conn *c, struct routingtable_item *to);
+static bool can_send_new(struct bcp_conn *c);
+static struct bcp_queue_item * next_unsent(struct bcp_conn *c);
 static void send_packet(void *ptr);
+static bool tx_data(struct bcp_conn *c);
 struct bcp_queue_item* push_packet_to_queue(struct bcp_conn *c);
-static void send_ack(struct bcp_conn *bc, const rimeaddr_t *to);
-static void retransmit_callback(void *ptr);
-static void setBusy(struct bcp_conn *bcp_conn, bool , char * sourceName);
-static int ackCoounter = 0;
+static void send_ack(struct bcp_conn *bc, const rimeaddr_t *to, uint8_t seq);
+static bool tx_ack(struct bcp_conn *bc, const rimeaddr_t *to, uint8_t seq);
+static void schedule_send(struct bcp_conn *c);
+static void update_rtt(struct routingtable_item *n, clock_time_t rtt);
+static clock_time_t retransmission_timeout(struct routingtable_item *n);
+static void tx_request(struct bcp_conn *c, uint8_t type, const rimeaddr_t *to, uint8_t seq);
+static void tx_run(struct bcp_conn *c, struct bcp_tx_op *op);
+static void tx_done(struct bcp_conn *c);
+
+//The opened connections, at their index
+static struct bcp_conn * connections[BCP_MAX_CONNECTIONS];
+
+int returnACK(struct bcp_conn *c){
+   return c->acks; 
+}
 
+void resetACK(struct bcp_conn *c){
+    c->acks = 0;
+}
 
-int returnACK(){
-   return ackCoounter; 
+/**
+ * \breif Encodes the given queue item into the packetbuf
+ * \return the length of the encoded packet
+ */
+static uint16_t encode_data_packet(struct bcp_conn *c, struct bcp_queue_item *i, uint8_t seq){
+    uint8_t ext = 0;
+    
+    if(c->ce != NULL && c->ce->encodeData != NULL)
+        ext = c->ce->encodeData(c, i);
+    
+    return bcp_wire_encode(i, ext, c->hop_counter.hop_count, seq, packetbuf_dataptr());
 }
 
-void resetACK(){
-    ackCoounter = 0;
+/**
+ * \breif Records the hop count advertised by a neighbor. The neighbors hear 
+ *        about a change of our own hop count with the next beacons.
+ */
+static void heard_hop_count(struct bcp_conn *c, const rimeaddr_t *from, uint16_t hop_count){
+    if(hop_counter_heard(c, from, hop_count))
+        reset_beacon(c);
+}
+
+/**
+ * \breif Decodes the data packet in the packetbuf, sent by from, into the given queue item
+ * \return zero if the packetbuf does not hold a valid data packet
+ */
+static int decode_data_packet(struct bcp_conn *c, const rimeaddr_t *from, struct bcp_queue_item *i, uint8_t *seq){
+    uint8_t ext;
+    uint16_t hops;
+    
+    if(!bcp_wire_decode(packetbuf_dataptr(), packetbuf_datalen(), i, &ext, &hops, seq))
+        return 0;
+    
+    heard_hop_count(c, from, hops);
+    
+    if(c->ce != NULL && c->ce->decodeData != NULL)
+        c->ce->decodeData(c, i, ext);
+    
+    return 1;
 }
 
 /*********************************CALLBACKS************************************/
@@ -100,7 +175,7 @@ static void recv_from_unicast(struct unicast_conn *c, const rimeaddr_t *from)
 {
     struct bcp_queue_item *i;
     struct ack_msg m;
-    struct routingtable_item * ri;
+    struct bcp_inflight *f;
 
     PRINTF("DEBUG: Receiving an ACK via the unicast channel\n");
     
@@ -109,20 +184,17 @@ static void recv_from_unicast(struct unicast_conn *c, const rimeaddr_t *from)
     struct bcp_conn *bcp_conn = (struct bcp_conn *)((char *)c
         - offsetof(struct bcp_conn, unicast_conn));
     
-    setBusy(bcp_conn, true, "recv_from_unicast");
-    
     //Copy the header
     memcpy(&m, packetbuf_dataptr(), sizeof(struct ack_msg));
     
-    //Remove the packet from the packet queue
-    i = bcp_queue_top(&bcp_conn->packet_queue);
+    //Find the acknowledged packet among the packets waiting for their ACK
+    f = find_inflight(bcp_conn, from, m.seq);
     
-    if(i != NULL) {
+    if(f != NULL) {
+        i = f->item;
+        f->item = NULL;
       
-        PRINTF("DEBUG: ACK received removing the current active packet from the queue\n");
-        // Reset BCP connection for next packet to send
-        bcp_conn->tx_attempts = 0;
-        
+        PRINTF("DEBUG: ACK received for packet seq=%d, removing it from the queue\n", m.seq);
         
         //Notify user that this packet has been sent
         if(bcp_conn->cb->sent != NULL){
@@ -131,23 +203,35 @@ static void recv_from_unicast(struct unicast_conn *c, const rimeaddr_t *from)
             bcp_conn->cb->sent(bcp_conn);        
         }
         
-        //Remove the packet from the queue
-        bcp_queue_remove(&bcp_conn->packet_queue, i);
-        
         struct routingtable_item* neigh = routing_table_find(&bcp_conn->routing_table, from);
+        if(neigh != NULL)
+            neigh->last_heard = clock_time();
         if(neigh != NULL && neigh->backpressure > 5)
          neigh->backpressure -= 5; //Increase neighbor weight if the ACK not received 
         
-        ackCoounter++;
+        //Only the ACK of a packet sent once tells which transmission it answers (Karn)
+        if(neigh != NULL && f->attempts == 1)
+            update_rtt(neigh, clock_time() - f->sent);
+        
+        //Notify the weight estimator
+        if(neigh != NULL)
+            weight_estimator_sent(neigh, i, f->attempts, clock_time() - f->first);
+        
+        //Remove the packet from the queue, once nothing uses it anymore
+        bcp_queue_remove(&bcp_conn->packet_queue, i);
+        
+        //Its weight changed
+        if(neigh != NULL)
+            routingtable_changed(&bcp_conn->routing_table, neigh);
+        
+        bcp_conn->acks++;
         
-        // // Reset the send data timer in case their are other packets in the queue
-       // retransmit_callback(bcp_conn);
+        //A window slot is free again
+        schedule_send(bcp_conn);
         
     }else{
-        PRINTF("ERROR: Cannot find the current active packet. ACK cannot be sent\n");
+        PRINTF("ERROR: No packet is waiting for the ACK seq=%d\n", m.seq);
     }
-    
-    setBusy(bcp_conn, false, "recv_from_unicast");
 }
 
 /**
@@ -170,8 +254,6 @@ static void recv_from_broadcast(struct broadcast_conn *c,
     rimeaddr_t destinationAddress;
     rimeaddr_copy(&destinationAddress, packetbuf_addr(PACKETBUF_ADDR_ERECEIVER));
     
-     setBusy(bc, true, "recv_from_broadcast");
-    
     //If it is a broadcast
     if(isBroadcast(&destinationAddress)){
         //It is either beacon or beacon request. 
@@ -181,57 +263,80 @@ static void recv_from_broadcast(struct broadcast_conn *c,
             //Construct the beacon message
             struct beacon_msg beacon;
             memcpy(&beacon, packetbuf_dataptr(), sizeof(struct beacon_msg));
-             PRINTF("DEBUG: Receiving a beacon from node[%d].[%d] and new queuelength=%d\n", 
+             PRINTF("DEBUG: Receiving a beacon from node[%d].[%d] and new queuelength=%d, hop-count=%d\n", 
                      from->u8[0], 
                      from->u8[1],
-                     beacon.queuelog);
+                     beacon.queuelog,
+                     beacon.hop_count);
    
+            //A new neighbor should hear about us soon
+            if(routing_table_find(&bc->routing_table, from) == NULL)
+                reset_beacon(bc);
+            
             //Update the queue for that neighbor
             routing_table_update_queuelog(&bc->routing_table, from, beacon.queuelog, 0);
+            heard_hop_count(bc, from, beacon.hop_count);
           
+        }else if(isBeaconRequest()){
+            //The neighbor asks for our queue length
+            reset_beacon(bc);
         }
         
     }else //If this node is the destination 
         if(rimeaddr_cmp(&destinationAddress, &rimeaddr_node_addr)){
+            rimeaddr_t origin;
+            uint16_t origin_seq;
+            uint8_t seq;
             
-            //Abstract the message
-            struct bcp_queue_item * dm = (struct bcp_queue_item *) packetbuf_dataptr();
-            
-            if(bc->ce != NULL && bc->ce->onReceivingData != NULL)
-                        bc->ce->onReceivingData(bc, dm);
-                    
-            PRINTF("DEBUG: Received a forwarded data packet sent to node[%d].[%d] (Origin: [%d][%d]), BCP=%d, delay=%x",
-                  destinationAddress.u8[0], 
-                  destinationAddress.u8[1], 
-                  dm->hdr.origin.u8[0],
-                  dm->hdr.origin.u8[1],
-                  dm->hdr.bcp_backpressure,
-                  dm->hdr.delay);
-            //MSP430 Limitations 
-            PRINTF(", len=%d\n", 
-                  dm->hdr.packet_length);
-            PRINTF(", len=%d\n", 
-                  dm->hdr.packet_length);
-            
-            if(!bc->isSink){
-                //Add this packet to the queue so that we can forward it in the near future
+            if(bcp_wire_id(packetbuf_dataptr(), packetbuf_datalen(), &origin, &origin_seq, &seq)
+                    && isRecentPacket(bc, from, &origin, origin_seq, seq)){
+                //Our ACK was lost and the packet was sent again, or a copy of the packet came along 
+                //another path; acknowledge it without queueing it twice
+                PRINTF("DEBUG: Duplicate data packet seq=%d from node[%d].[%d], sending the ACK again\n", 
+                        seq, from->u8[0], from->u8[1]);
+                send_ack(bc, from, seq);
+                
+            }else if(!bc->isSink){
+                //Decode the packet straight into its queue record so that we can forward it in the near future
                 struct bcp_queue_item* itm;
-                itm = bcp_queue_push(&bc->packet_queue, dm);
-                 //Notify the extender
+                itm = bcp_queue_reserve(&bc->packet_queue);
                
-                if(itm != NULL){
-                     itm->hdr.lastProcessTime = clock_time();
-                    
+                if(itm != NULL && decode_data_packet(bc, from, itm, &seq)){
+                     uint16_t backpressure = itm->hdr.bcp_backpressure;
                      
-                      //Update the routing table
-                      routing_table_update_queuelog(&bc->routing_table, from, dm->hdr.bcp_backpressure, 1);
+                     //Update the routing table
+                     routing_table_update_queuelog(&bc->routing_table, from, backpressure, 1);
+                     
+                     //Its retransmissions and copies are not queued again
+                     addRecentPacket(bc, from, itm, seq);
+                     
+                     //Notify the extender
+                     if(bc->ce != NULL && bc->ce->onReceivingData != NULL)
+                        bc->ce->onReceivingData(bc, itm);
+                     
+                     PRINTF("DEBUG: Received a forwarded data packet sent to node[%d].[%d] (Origin: [%d][%d]), BCP=%d, delay=%x\n",
+                           destinationAddress.u8[0], 
+                           destinationAddress.u8[1], 
+                           itm->hdr.origin.u8[0],
+                           itm->hdr.origin.u8[1],
+                           backpressure,
+                           itm->hdr.delay);
+                     
+                     itm->hdr.lastProcessTime = clock_time();
+                     //The extender may merge the packet into one already queued
+                     if(bc->ce != NULL && bc->ce->mergeData != NULL 
+                             && bc->ce->mergeData(bc, itm) != NULL)
+                         bcp_queue_release(&bc->packet_queue, itm);
+                     else
+                         bcp_queue_commit(&bc->packet_queue, itm);
                
                       //Send ACK
-                      send_ack(bc, from);
+                      send_ack(bc, from, seq);
                
                      
                 }else{
-                    PRINTF("ERROR: Packet Queue is full. ACK will not be sent to node[%d].[%d]\n", 
+                    bcp_queue_release(&bc->packet_queue, itm);
+                    PRINTF("ERROR: Packet Queue is full or the packet is invalid. ACK will not be sent to node[%d].[%d]\n", 
                             from->u8[0], from->u8[1]);
                 }
                 
@@ -241,35 +346,49 @@ static void recv_from_broadcast(struct broadcast_conn *c,
              }else{
                 PRINTF("Before saving the message\n");
                 
-               //Save the message
-               char pk[dm->hdr.packet_length];
-               struct bcp_queue_item* bcp_pk = &pk;
-               memcpy(&pk, dm, dm->hdr.packet_length);
+               //Decode the message into a record as large as the queue items of the extender
+               struct bcp_queue_item pk[(bc->packet_queue.memb->size + sizeof(struct bcp_queue_item) - 1) 
+                                        / sizeof(struct bcp_queue_item)];
+               struct bcp_queue_item* bcp_pk = pk;
                
-               PRINTF("After saving the message\n");
-                //If it is Sink
-               PRINTF("DEBUG: Sink Received a new data packet from node[%d].[%d], user will be notified, total delay(ms)=%x\n", 
-                       bcp_pk->hdr.origin.u8[0], 
-                       bcp_pk->hdr.origin.u8[1],
-                       dm->hdr.delay);
-               printf("delay=%ld\n", dm->hdr.delay);
-               //Send ACK
-               send_ack(bc, from);
-
-               //Notify end user callbacks
-               //We need to rebuild packetbuf since we called send_ack
-               prepare_packetbuf();
+               if(decode_data_packet(bc, from, bcp_pk, &seq)){
+                   //Update the routing table
+                   routing_table_update_queuelog(&bc->routing_table, from, bcp_pk->hdr.bcp_backpressure, 0);
+                   addRecentPacket(bc, from, bcp_pk, seq);
+                   
+                   //Account the packet in the load of this sink
+                   sink_load_update(bc);
+                   bc->sink_intake++;
+                   bc->sink_slot_intake++;
+                   if(bc->ce != NULL && bc->ce->onReceivingData != NULL)
+                        bc->ce->onReceivingData(bc, bcp_pk);
                
-               memcpy(packetbuf_dataptr(), &bcp_pk->data, MAX_USER_PACKET_SIZE);
-                        
-               //Notify user callback
-               if(bc->cb->recv != NULL)
-                  bc->cb->recv(bc, &bcp_pk->hdr.origin);
-               else 
-                  PRINTF("ERROR: BCP cannot notify user as the receive callback function is not set.\n");
-               
-               //Update the routing table
-               routing_table_update_queuelog(&bc->routing_table, from, bcp_pk->hdr.bcp_backpressure, 0);
+                   PRINTF("After saving the message\n");
+                    //If it is Sink
+                   PRINTF("DEBUG: Sink Received a new data packet from node[%d].[%d], user will be notified, total delay(ms)=%x\n", 
+                           bcp_pk->hdr.origin.u8[0], 
+                           bcp_pk->hdr.origin.u8[1],
+                           bcp_pk->hdr.delay);
+#if SINK_OUTPUT_BINARY
+                   sink_output_packet(bc, bcp_pk);
+#else
+                   printf("delay=%ld\n", bcp_pk->hdr.delay);
+#endif
+                   //Send ACK
+                   send_ack(bc, from, seq);
+
+                   //Notify end user callbacks
+                   //We need to rebuild packetbuf since we called send_ack
+                   prepare_packetbuf();
+                   
+                   memcpy(packetbuf_dataptr(), &bcp_pk->data, MAX_USER_PACKET_SIZE);
+                            
+                   //Notify user callback
+                   if(bc->cb->recv != NULL)
+                      bc->cb->recv(bc, &bcp_pk->hdr.origin);
+                   else 
+                      PRINTF("ERROR: BCP cannot notify user as the receive callback function is not set.\n");
+               }
             }
 
            
@@ -277,22 +396,28 @@ static void recv_from_broadcast(struct broadcast_conn *c,
     }else{
         //When the node is not the destination for the data pack. Just abstract 
         //the queue log from the packet
-         struct bcp_queue_item * dm = (struct bcp_queue_item *) packetbuf_dataptr();
+         struct bcp_queue_item dm;
+         uint8_t ext, seq;
+         uint16_t hops;
+         
+         if(bcp_wire_decode(packetbuf_dataptr(), packetbuf_datalen(), &dm, &ext, &hops, &seq)){
             PRINTF("DEBUG: Received a forwarded data packet sent to node[%d].[%d] (Origin: [%d][%d]), BCP=%d, delay=%x \n",
                   destinationAddress.u8[0], 
                   destinationAddress.u8[1], 
-                  dm->hdr.origin.u8[0],
-                  dm->hdr.origin.u8[1],
-                  dm->hdr.bcp_backpressure,
-                  dm->hdr.delay);
+                  dm.hdr.origin.u8[0],
+                  dm.hdr.origin.u8[1],
+                  dm.hdr.bcp_backpressure,
+                  dm.hdr.delay);
             
-      
-        
-        routing_table_update_queuelog(&bc->routing_table, from, dm->hdr.bcp_backpressure, 0);
+            routing_table_update_queuelog(&bc->routing_table, from, dm.hdr.bcp_backpressure, 0);
+            heard_hop_count(bc, from, hops);
+         }
     }
      
-     setBusy(bc, false, "recv_from_broadcast");
-    
+     //The routing table or the queue may have changed
+     if(bc->send_blocked == BCP_BLOCKED_NO_NEIGHBOR)
+         bc->send_blocked = 0;
+     schedule_send(bc);
 }
 
 
@@ -314,18 +439,24 @@ static void sent_from_broadcast(struct broadcast_conn *c, int status,
     struct bcp_conn *bcp_conn = (struct bcp_conn *)((char *)c
       - offsetof(struct bcp_conn, broadcast_conn));
 
-    // If it is a beacon
-    if(isBeacon()) {
-      setBusy(bcp_conn, false, "sent_from_broadcast#beacon");
+    //The channel is free again, whatever has been sent
+    tx_done(bcp_conn);
+}
 
-      
-    }else if(isBeaconRequest()){
-         setBusy(bcp_conn, false, "sent_from_broadcast#beaconRequest");
-         
-    }else{
-       setBusy(c, false, "sent_from_broadcast#data");
+/**
+ * \brief Called when an ACK has been sent via the unicast channel
+ * \param c A pointer to the unicast channel
+ * \param status the result of sending
+ * \param transmissions number of attempts 
+ */
+static void sent_from_unicast(struct unicast_conn *c, int status,
+                              int transmissions)
+{
+    // Cast the unicast connection as a BCP connection
+    struct bcp_conn *bcp_conn = (struct bcp_conn *)((char *)c
+        - offsetof(struct bcp_conn, unicast_conn));
     
-    }
+    tx_done(bcp_conn);
 }
 
 /**
@@ -334,7 +465,9 @@ static void sent_from_broadcast(struct broadcast_conn *c, int status,
 static const struct broadcast_callbacks broadcast_callbacks = {
     recv_from_broadcast,
     sent_from_broadcast };
-static const struct unicast_callbacks unicast_callbacks = { recv_from_unicast };
+static const struct unicast_callbacks unicast_callbacks = {
+    recv_from_unicast,
+    sent_from_unicast };
 /******************************************************************************/
 
 /*********************************UTILITIES************************************/
@@ -350,6 +483,27 @@ static bool isBroadcast(rimeaddr_t * addr){
     return (rimeaddr_cmp(&broadcastAddress, addr));
 }
 
+/**
+ * \breif Closes the time slots of the sink load which are over
+ * \param c the bcp connection of a sink
+ */
+static void sink_load_update(struct bcp_conn *c){
+    clock_time_t slot = CLOCK_SECOND * SLOT_DURATION;
+    uint8_t k;
+    
+    for(k = 0; (clock_time_t)(clock_time() - c->sink_slot_start) >= slot; k++){
+        //After a long silence the load is zero anyway
+        if(k == 32){
+            c->sink_slot_start = clock_time();
+            break;
+        }
+        c->sink_load = (SINK_LOAD_ALPHA * (uint32_t) c->sink_load 
+                        + (10 - SINK_LOAD_ALPHA) * 16 * (uint32_t) c->sink_slot_intake) / 10;
+        c->sink_slot_intake = 0;
+        c->sink_slot_start += slot;
+    }
+}
+
 
 
 /**
@@ -369,27 +523,215 @@ static bool isBeaconRequest(){
 }
 
 
+/**
+ * \return true if the data packet has already been received.
+ * 
+ *      The neighbor numbers the packets it sends to this node and keeps the 
+ *      ones waiting for their ACK within BCP_TX_WINDOW sequence numbers, so a 
+ *      packet below rx_seq or marked in rx_mask is a retransmission. When this 
+ *      node has not received from the neighbor within BCP_RECENT_TIME, the 
+ *      packets remembered lately tell it instead. Backpressure routing lets a 
+ *      packet come back to a node it has already left, so only the sink, 
+ *      which the packets never leave, recognizes a packet by its origin alone.
+ */
+static bool isRecentPacket(struct bcp_conn *c, const rimeaddr_t *from, const rimeaddr_t *origin, uint16_t origin_seq, uint8_t seq){
+    clock_time_t now = clock_time();
+    struct routingtable_item *neigh = routing_table_find(&c->routing_table, from);
+    struct bcp_queue_item *i;
+    uint8_t k, d;
+    bool known = neigh != NULL && neigh->rx_valid 
+            && (clock_time_t)(now - neigh->rx_heard) < BCP_RECENT_TIME;
+    
+    if(known){
+        d = seq - neigh->rx_seq;
+        //Behind the window, or within it and received already
+        if(d >= 0x80 || (d < BCP_TX_WINDOW && (neigh->rx_mask & (1 << d))))
+            return true;
+    }
+    
+    for(k = 0; k < BCP_RECENT_SIZE; k++){
+        struct bcp_recent *r = &c->recent[k];
+        if(r->origin_seq != origin_seq || !rimeaddr_cmp(&r->origin, origin)
+                || (clock_time_t)(now - r->heard) >= BCP_RECENT_TIME)
+            continue;
+        if(c->isSink || (!known && r->seq == seq && rimeaddr_cmp(&r->from, from)))
+            return true;
+    }
+    
+    //A copy of a packet which has not left this node yet
+    for(i = bcp_queue_top(&c->packet_queue); i != NULL; i = bcp_queue_next(&c->packet_queue, i))
+        if(i->hdr.origin_seq == origin_seq && rimeaddr_cmp(&i->hdr.origin, origin))
+            return true;
+    return false;
+}
+
+/**
+ * \breif Remembers a data packet received from the given neighbor: marks its 
+ *        sequence number and replaces the oldest packet remembered
+ */
+static void addRecentPacket(struct bcp_conn *c, const rimeaddr_t *from, const struct bcp_queue_item *i, uint8_t seq){
+    clock_time_t now = clock_time();
+    struct routingtable_item *neigh = routing_table_find(&c->routing_table, from);
+    struct bcp_recent *r = &c->recent[c->recent_next];
+    uint8_t d;
+    
+    if(neigh != NULL){
+        //The packets waiting for an ACK of the neighbor are in the window ending with this one
+        if(!neigh->rx_valid || (clock_time_t)(now - neigh->rx_heard) >= BCP_RECENT_TIME){
+            neigh->rx_seq = seq - (BCP_TX_WINDOW - 1);
+            neigh->rx_mask = 0;
+            neigh->rx_valid = 1;
+        }
+        //Ahead of the window: the neighbor gave up the packets which slide out of it
+        d = seq - neigh->rx_seq;
+        if(d >= BCP_TX_WINDOW){
+            d -= BCP_TX_WINDOW - 1;
+            neigh->rx_mask = d < 8 ? neigh->rx_mask >> d : 0;
+            neigh->rx_seq += d;
+            d = BCP_TX_WINDOW - 1;
+        }
+        neigh->rx_mask |= 1 << d;
+        while(neigh->rx_mask & 1){
+            neigh->rx_mask >>= 1;
+            neigh->rx_seq++;
+        }
+        neigh->rx_heard = now;
+    }
+    
+    rimeaddr_copy(&r->origin, &i->hdr.origin);
+    r->origin_seq = i->hdr.origin_seq;
+    rimeaddr_copy(&r->from, from);
+    r->seq = seq;
+    r->heard = now;
+    c->recent_next = (c->recent_next + 1) % BCP_RECENT_SIZE;
+}
+
+/**
+ * \return the packet sent to the given neighbor with the given sequence number, 
+ *         NULL if it is not waiting for its ACK
+ */
+static struct bcp_inflight * find_inflight(struct bcp_conn *c, const rimeaddr_t *to, uint8_t seq){
+    uint8_t k;
+    for(k = 0; k < BCP_TX_INFLIGHT; k++)
+        if(c->inflight[k].item != NULL && c->inflight[k].seq == seq
+                && rimeaddr_cmp(&c->inflight[k].neighbor, to))
+            return &c->inflight[k];
+    return NULL;
+}
+
+/**
+ * \return the packet whose ACK has been waited for the longest, if it is due for a retransmission
+ */
+static struct bcp_inflight * due_inflight(struct bcp_conn *c){
+    struct bcp_inflight *due = NULL;
+    uint8_t k;
+    for(k = 0; k < BCP_TX_INFLIGHT; k++){
+        struct bcp_inflight *f = &c->inflight[k];
+        if(f->item != NULL && (due == NULL || CLOCK_LT(f->deadline, due->deadline)))
+            due = f;
+    }
+    if(due != NULL && CLOCK_LT(clock_time(), due->deadline))
+        return NULL;
+    return due;
+}
+
+/**
+ * \breif Drops a packet which has not been acknowledged within BCP_TX_LIFETIME
+ *        or whose neighbor has left the routing table
+ */
+static void drop_inflight(struct bcp_conn *c, struct bcp_inflight *f){
+    struct bcp_queue_item *i = f->item;
+    struct routingtable_item *neigh = routing_table_find(&c->routing_table, &f->neighbor);
+    
+    PRINTF("DEBUG: Packet seq=%d has not been acknowledged, dropping it\n", f->seq);
+    f->item = NULL;
+    
+    //The neighbor acknowledged none of the transmissions
+    if(neigh != NULL){
+        weight_estimator_sent(neigh, i, f->attempts + 1, clock_time() - f->first);
+        routingtable_changed(&c->routing_table, neigh);
+    }
+    
+    prepare_packetbuf();
+    packetbuf_copyfrom(i->data, MAX_USER_PACKET_SIZE);
+    packet_dropped(c);
+    bcp_queue_remove(&c->packet_queue, i);
+}
+
+/**
+ * \return a free entry of the window, NULL if the window is full
+ */
+static struct bcp_inflight * free_inflight(struct bcp_conn *c){
+    uint8_t k;
+    for(k = 0; k < BCP_TX_INFLIGHT; k++)
+        if(c->inflight[k].item == NULL)
+            return &c->inflight[k];
+    return NULL;
+}
+
+/**
+ * \return true if a new packet can be sent to the given neighbor: its 
+ *         sequence number stays within BCP_TX_WINDOW of every packet waiting 
+ *         for the ACK of that neighbor (see isRecentPacket())
+ */
+static bool window_open(struct bcp_conn *c, struct routingtable_item *to){
+    uint8_t k;
+    for(k = 0; k < BCP_TX_INFLIGHT; k++){
+        struct bcp_inflight *f = &c->inflight[k];
+        if(f->item != NULL && rimeaddr_cmp(&f->neighbor, &to->neighbor)
+                && (uint8_t)(to->tx_seq - f->seq) >= BCP_TX_WINDOW)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * \return true if a packet which has not been sent yet can be sent to the 
+ *         best neighbor, whose window is not full
+ */
+static bool can_send_new(struct bcp_conn *c){
+    rimeaddr_t *to;
+    struct routingtable_item *neigh;
+    
+    if(free_inflight(c) == NULL || next_unsent(c) == NULL)
+        return false;
+    to = routingtable_find_routing(&c->routing_table);
+    neigh = to == NULL ? NULL : routing_table_find(&c->routing_table, to);
+    return neigh == NULL || window_open(c, neigh);
+}
+
+/**
+ * \return the first packet of the queue which has not been sent yet, NULL if none
+ */
+static struct bcp_queue_item * next_unsent(struct bcp_conn *c){
+    struct bcp_queue_item *i;
+    uint8_t k;
+    for(i = bcp_queue_top(&c->packet_queue); i != NULL; i = bcp_queue_next(&c->packet_queue, i)){
+        for(k = 0; k < BCP_TX_INFLIGHT && c->inflight[k].item != i; k++)
+            ;
+        if(k == BCP_TX_INFLIGHT)
+            return i;
+    }
+    return NULL;
+}
+
 /**
  * \breif Broadcasts a beacon request message(see \ref "struct beacon_request_msg") to the one-hop neighbors.
  * \param ptr the bcp connection
  * 
  */
 static void send_beacon_request(void * ptr){
-    struct bcp_conn *c = ptr; 
+    tx_request((struct bcp_conn *)ptr, BCP_TX_BEACON_REQUEST, NULL, 0);
+}
+
+/**
+ * \breif Sends the beacon request as soon as the channel is free, see send_beacon_request()
+ * \param c the bcp connection
+ * \return true if the request occupies the channel, false if the channel refused it
+ */
+static bool tx_beacon_request(struct bcp_conn *c){
     struct beacon_request_msg * br_msg;
-    
-    if(c->busy == false)
-        setBusy(c, true, "send_beacon_request");
-    else{
-        if(c->isSink == true){
-                // Reset the beacon timer
-          if(ctimer_expired(&c->beacon_timer)) {
-            clock_time_t time = BEACON_TIME * 5;
-            ctimer_set(&c->beacon_timer, time, send_beacon, c);
-          }
-        }
-        return;
-    }
+    bool sent;
     
     //Delete all the records in the routing table
     //routingtable_clearForwardable(&c->routing_table);
@@ -398,10 +740,10 @@ static void send_beacon_request(void * ptr){
     packetbuf_set_datalen(sizeof(struct beacon_request_msg));
     
     br_msg = packetbuf_dataptr();
-    memset(br_msg, 0, sizeof(br_msg));
+    memset(br_msg, 0, sizeof(*br_msg));
     
     // Store the local backpressure level to the backpressure field
-    br_msg->queuelog = bcp_queue_length(&c->packet_queue);
+    br_msg->queuelog = bcp_backlog(c);
      
     //Update the packet buffer 
     //TDOO: Check if this is required
@@ -414,12 +756,49 @@ static void send_beacon_request(void * ptr){
     PRINTF("DEBUG: Beacon Request sent via the broadcast channel. BCP=%d\n",  br_msg->queuelog);
     
     // Broadcast the beacon
-    broadcast_send(&c->broadcast_conn);
+    sent = broadcast_send(&c->broadcast_conn) != 0;
     
     // Reset the beacon timer
-    if(ctimer_expired(&c->beacon_timer)) {
-        clock_time_t time = BEACON_TIME;
-        ctimer_set(&c->beacon_timer, time, send_beacon, c);
+    schedule_beacon(c);
+    return sent;
+}
+
+/**
+ * \breif Starts the beacon timer, unless it is already running
+ * \param c the bcp connection
+ * 
+ *      As in trickle, the beacon is sent at a random time in the second half 
+ *      of the current beacon interval. A queue length far from the advertised 
+ *      one resets the interval first.
+ */
+static void schedule_beacon(struct bcp_conn *c){
+    int delta = (int) bcp_backlog(c) - c->advertised_queuelog;
+    clock_time_t half;
+    
+    if(delta >= BEACON_QUEUE_DELTA || delta <= -BEACON_QUEUE_DELTA)
+        reset_beacon(c);
+    
+    if(ctimer_expired(&c->beacon_timer)){
+        half = c->beacon_interval / 2;
+        ctimer_set(&c->beacon_timer, half + random_rand() % (half + 1), send_beacon, c);
+    }
+}
+
+/**
+ * \breif Goes back to the shortest beacon interval
+ * \param c the bcp connection
+ */
+static void reset_beacon(struct bcp_conn *c){
+    if(c->beacon_interval == BEACON_TIME)
+        return;
+    
+    PRINTF("DEBUG: Resetting the beacon interval\n");
+    c->beacon_interval = BEACON_TIME;
+    
+    //A beacon scheduled later than the new interval is scheduled again
+    if(!ctimer_expired(&c->beacon_timer)){
+        ctimer_stop(&c->beacon_timer);
+        schedule_beacon(c);
     }
 }
 
@@ -434,25 +813,50 @@ static void send_beacon_request(void * ptr){
  */
 static void send_beacon(void *ptr)
 {
-  struct bcp_conn *c = ptr; 
-  struct beacon_msg *beacon;
+  PRINTF("DEBUG: Send Beacon timer has been triggered\n");
+  tx_request((struct bcp_conn *)ptr, BCP_TX_BEACON, NULL, 0);
+}
 
-  PRINTF("DEBUG: Send Beacon timer has been triggered. c->busy=%d\n",c->busy);
-   
-  //Check if the channel is free 
-  if(c->busy == false)
-    setBusy(c, true, "send_beacon");
-  else
-    return;
+/**
+ * \breif Builds and broadcasts the beacon once the channel is free, see send_beacon()
+ * \param c The opened BCP connection
+ * \return true if the beacon occupies the channel, false if it has been 
+ *         suppressed or the channel refused it
+ */
+static bool tx_beacon(struct bcp_conn *c)
+{
+  struct beacon_msg *beacon;
+  int delta;
+  bool sent;
+  
+  delta = (int) bcp_backlog(c) - c->advertised_queuelog;
+  if(delta < BEACON_QUEUE_DELTA && delta > -BEACON_QUEUE_DELTA){
+      //Nothing new to say; wait twice as long for the next beacon
+      c->beacon_interval *= 2;
+      if(c->beacon_interval > BEACON_MAX_TIME)
+          c->beacon_interval = BEACON_MAX_TIME;
+      
+      //Our last data packet told the neighbors the same
+      if(c->advertised){
+          PRINTF("DEBUG: Beacon suppressed, a data packet advertised the queue length\n");
+          c->advertised = false;
+          c->beacons_suppressed++;
+          schedule_beacon(c);
+          return false;
+      }
+  }else{
+      c->beacon_interval = BEACON_TIME;
+  }
 
   //Prepare the packet for the beacon 
   prepare_packetbuf();
   packetbuf_set_datalen(sizeof(struct beacon_msg));
   beacon = packetbuf_dataptr();
-  memset(beacon, 0, sizeof(beacon));
+  memset(beacon, 0, sizeof(*beacon));
    
   // Store the local backpressure level to the backpressure field
-  beacon->queuelog = bcp_queue_length(&c->packet_queue); 
+  beacon->queuelog = bcp_backlog(c); 
+  beacon->hop_count = c->hop_counter.hop_count;
 
   //Update the packet buffer
   //TDOO: Check if this is required
@@ -463,9 +867,20 @@ static void send_beacon(void *ptr)
                      PACKETBUF_ATTR_PACKET_TYPE_BEACON);
    
   PRINTF("DEBUG: Sending a beacon via the broadcast channel. BCP=%d\n",  beacon->queuelog);
+  
+  c->advertised_queuelog = beacon->queuelog;
+  c->advertised = false;
     
   // Broadcast the beacon
-  broadcast_send(&c->broadcast_conn);
+  sent = broadcast_send(&c->broadcast_conn) != 0;
+  if(sent)
+      c->beacons_sent++;
+  else
+      PRINTF("ERROR: The beacon could not be sent\n");
+  
+  //Beacons keep going until data packets are sent
+  schedule_beacon(c);
+  return sent;
 }
 
 /**
@@ -476,7 +891,7 @@ static void send_beacon(void *ptr)
  struct bcp_queue_item* push_packet_to_queue(struct bcp_conn *c){
 
   
-     struct bcp_queue_item newRow;
+     struct bcp_queue_item * newRow;
     
     //Packetbuf should not be empty
     if(packetbuf_dataptr() == NULL){
@@ -484,43 +899,135 @@ static void send_beacon(void *ptr)
         return NULL;
     }
     
-    //Sets the fields of the new record
-    newRow.next = NULL;
-    newRow.hdr.bcp_backpressure = 0;
-    newRow.hdr.packet_length = sizeof(struct bcp_queue_item);
-    memcpy(newRow.data, packetbuf_dataptr(), MAX_USER_PACKET_SIZE);
-    
+    //The packet is written straight into its queue record
+    newRow = bcp_queue_reserve(&c->packet_queue);
+    if(newRow == NULL)
+        return NULL;
     
+    //Sets the fields of the new record
+    newRow->hdr.packet_length = sizeof(struct bcp_queue_item);
+    memcpy(newRow->data, packetbuf_dataptr(), MAX_USER_PACKET_SIZE);
+    //The origin is known before the packet is committed so the queue can group it
+    rimeaddr_copy(&newRow->hdr.origin, &rimeaddr_node_addr);
+    newRow->hdr.origin_seq = c->origin_seq++;
+    newRow->hdr.merged = 0;
+    newRow->hdr.delay = 0;
+    newRow->hdr.lastProcessTime = clock_time();
     
-    struct bcp_queue_item * result = bcp_queue_push(&c->packet_queue, &newRow);
+    if(c->ce != NULL && c->ce->onUserSendRequest != NULL)
+                c->ce->onUserSendRequest(c, newRow);
     
-    if(c->ce != NULL && c->ce->onUserSendRequest != NULL && result != NULL)
-                c->ce->onUserSendRequest(c, result);
+    //The extender may merge the packet into one already queued
+    if(c->ce != NULL && c->ce->mergeData != NULL){
+        struct bcp_queue_item * merged = c->ce->mergeData(c, newRow);
+        if(merged != NULL){
+            bcp_queue_release(&c->packet_queue, newRow);
+            return merged;
+        }
+    }
     
-    return result;
+    return bcp_queue_commit(&c->packet_queue, newRow);
     
     
 }
  
  
 /**
- * \breif Called by the retransmission timer
- * \param ptr the bcp connection
+ * \breif Adds a data-to-ACK round trip time sample to the estimate of the neighbor
+ * \param n the neighbor which sent the ACK
+ * \param rtt the time between sending the data packet and receiving its ACK
  * 
- *     Every BCP connection has a retransmission timer. retransmission timer is 
- *     used to send a beacon request message when no ACK message is received. 
+ *     Same smoothing as TCP (RFC 6298): srtt moves 1/8 and rttvar 1/4 of the 
+ *     way towards the new sample.
  */
-static void retransmit_callback(void *ptr)
-{
-    struct bcp_conn *c = ptr;
-    PRINTF("DEBUG: Attempt to retransmit the data packet\n");
-   
-    //Reschedule the send timer.
-    if(!c->isSink && ctimer_expired(&c->send_timer)) {
-        clock_time_t time = RETX_TIME * (c->tx_attempts+1);
-        ctimer_set(&c->send_timer, time, send_packet, c); 
+static void update_rtt(struct routingtable_item *n, clock_time_t rtt){
+    int delta;
+    
+    //srtt == 0 means no sample, so the shortest sample is one tick
+    if(rtt == 0)
+        rtt = 1;
+    else if(rtt > RETX_MAX_TIME)
+        rtt = RETX_MAX_TIME;
+    
+    if(n->srtt == 0){
+        //First sample
+        n->srtt = rtt << 3;
+        n->rttvar = rtt << 1;
+    }else{
+        delta = (int) rtt - (n->srtt >> 3);
+        n->srtt += delta;
+        if(delta < 0)
+            delta = -delta;
+        n->rttvar += delta - (n->rttvar >> 2);
     }
+    PRINTF("DEBUG: RTT of node[%d].[%d] rtt=%d srtt=%d rttvar=%d\n", 
+            n->neighbor.u8[0], n->neighbor.u8[1], (int) rtt, n->srtt >> 3, n->rttvar >> 2);
+}
 
+/**
+ * \return the time to wait for the ACK of a data packet sent to the given neighbor
+ */
+static clock_time_t retransmission_timeout(struct routingtable_item *n){
+    clock_time_t rto;
+    
+    //No ACK has been received from this neighbor yet
+    if(n == NULL || n->srtt == 0)
+        return RETX_TIME;
+    
+    rto = (n->srtt >> 3) + n->rttvar;
+    if(rto < RETX_MIN_TIME)
+        rto = RETX_MIN_TIME;
+    else if(rto > RETX_MAX_TIME)
+        rto = RETX_MAX_TIME;
+    return rto;
+}
+
+/**
+ * \breif Arms the send timer for the next thing the send path has to do
+ * \param c the bcp connection
+ * 
+ *     The send timer only runs when there is something to do: a packet which 
+ *     can be sent now, or the deadline of a packet waiting for its ACK. While 
+ *     sending is blocked, due packets wait for bcp_wakeup() instead.
+ */
+static void schedule_send(struct bcp_conn *c){
+    clock_time_t now = clock_time();
+    clock_time_t time = 0;
+    bool armed = false;
+    uint8_t k;
+    
+    if(c->isSink || !c->isOpen)
+        return;
+    
+    if(!c->send_blocked && (due_inflight(c) != NULL || can_send_new(c))){
+        //Keep a gap between two packets
+        time = WINDOW_SEND_TIME;
+        armed = true;
+    }else{
+        //Wake up for the next retransmission
+        for(k = 0; k < BCP_TX_INFLIGHT; k++){
+            struct bcp_inflight *f = &c->inflight[k];
+            if(f->item == NULL || !CLOCK_LT(now, f->deadline))
+                continue;
+            if(!armed || (clock_time_t)(f->deadline - now) < time){
+                time = f->deadline - now;
+                armed = true;
+            }
+        }
+    }
+    
+    if(!armed){
+        PRINTF("DEBUG: Nothing to send, the send timer is idle\n");
+        //Keep the neighbors informed while no data packet is sent
+        schedule_beacon(c);
+        return;
+    }
+    
+    //Only move the timer earlier
+    if(ctimer_expired(&c->send_timer) || CLOCK_LT(now + time, c->send_at)){
+        c->send_at = now + time;
+        ctimer_set(&c->send_timer, time, send_packet, c);
+    }
 }
 
 
@@ -528,35 +1035,61 @@ static void retransmit_callback(void *ptr)
   * \breif Sends user data packet via the broadcast channel for the given bcp connection.
   * \param ptr the bcp connection.
   * 
-  *     This function sends the top packet in the packet queue of the given bcp 
+  *     This function sends one packet of the packet queue of the given bcp 
   *     connection. It is usually called by the 'send' timer. Each opened bcp 
   *     channel has a timer to send the packets existing in the packet queue. 
   *     
+  *     Up to BCP_TX_WINDOW packets wait for the ACK of the same neighbor. A 
+  *     packet whose ACK is overdue is sent again first, always to the same 
+  *     neighbor, and dropped once BCP_TX_LIFETIME has passed. Otherwise the 
+  *     first packet of the queue which has not been sent yet is sent if the 
+  *     window of the best neighbor is not full.
   */
  static void send_packet(void *ptr)
 {
-    struct bcp_conn *c = ptr;
-    struct bcp_queue_item * i;
-    
-    PRINTF("DEBUG: Send packet timer has been triggered. c->busy=%d\n", c->busy);
+    PRINTF("DEBUG: Send packet timer has been triggered\n");
+    tx_request((struct bcp_conn *)ptr, BCP_TX_DATA, NULL, 0);
+}
+
+ /**
+  * \breif Sends the next data packet once the channel is free, see send_packet()
+  * \param c the bcp connection
+  * \return true if a data packet occupies the channel
+  */
+ static bool tx_data(struct bcp_conn *c)
+{
+    struct bcp_queue_item * i = NULL;
+    struct bcp_inflight * f;
+    struct routingtable_item* neigh = NULL;
+    rimeaddr_t* neighborAddr = NULL;
+    clock_time_t backoff;
     
-    // If it is busy, just return and wait for the second opportunity
-    if(c->busy == true){
-        PRINTF("DEBUG: BCP is currently busy. Resend the data packets later\n");
-        
-        //Reschedule the send timer. 
-        retransmit_callback(c);
-        return;
+    //Retransmissions first, then new packets while the window is not full
+    f = due_inflight(c);
+    if(f != NULL){
+        //Only the ACK may have been lost; sending the packet to another 
+        //neighbor would make a second copy of it
+        neigh = routing_table_find(&c->routing_table, &f->neighbor);
+        if(neigh == NULL || (clock_time_t)(clock_time() - f->first) >= BCP_TX_LIFETIME){
+            drop_inflight(c, f);
+            schedule_send(c);
+            return false;
+        }
+        i = f->item;
+        neighborAddr = &neigh->neighbor;
+    }else{
+        //Find the best neighbor to send
+        neighborAddr = routingtable_find_routing(&c->routing_table);
+        neigh = neighborAddr == NULL ? NULL : routing_table_find(&c->routing_table, neighborAddr);
+        if(neigh != NULL && free_inflight(c) != NULL && window_open(c, neigh))
+            i = next_unsent(c);
     }
     
-    //Preparing bcp to send a new message
-    setBusy(c, true, "send_packet");
-    
-    i = bcp_queue_top(&c->packet_queue);
-   
-    //Find the best neighbor to send
-    rimeaddr_t* neighborAddr = routingtable_find_routing(&c->routing_table);
-    
+    if(i == NULL && neighborAddr != NULL && bcp_queue_top(&c->packet_queue) != NULL){
+        PRINTF("DEBUG: The window is full, waiting for ACKs\n");
+        schedule_send(c);
+        return false;
+    }
  
     if( i == NULL || neighborAddr == NULL){
          if(neighborAddr == NULL)
@@ -564,24 +1097,29 @@ static void retransmit_callback(void *ptr)
         else
              PRINTF("DEBUG: Packet queue is empty; start beaconing \n");
         
-        setBusy(c, false, "send_packet");
         // Start beaconing
-        if(ctimer_expired(&c->beacon_timer)){
-            clock_time_t time = BEACON_TIME;
-            ctimer_set(&c->beacon_timer, time, send_beacon, c);
-        }
+        schedule_beacon(c);
         
-        // Resend the send data timer
-        retransmit_callback(c);
-        return;
+        // Wait for a neighbor before trying again
+        if(neighborAddr == NULL && bcp_queue_top(&c->packet_queue) != NULL){
+            c->send_blocked = BCP_BLOCKED_NO_NEIGHBOR;
+            
+            //Knowing no neighbor at all, ask the ones around for their queue 
+            //length rather than waiting for their beacons
+            if(routingtable_length(&c->routing_table) == 0)
+                send_beacon_request(c);
+        }
+        schedule_send(c);
+        return false;
     }
      
     // Stop beaconing
     if(!ctimer_expired(&c->beacon_timer)) {
         ctimer_stop(&c->beacon_timer);
     }
-   if(c->ce != NULL && c->ce->prepareSendingData != NULL)
-    c->ce->prepareSendingData(c, i);
+    if(c->ce != NULL && c->ce->prepareSendingData != NULL)
+        c->ce->prepareSendingData(c, i);
+    
     //Clear the header of the packet
     prepare_packetbuf();
     // Set the packet type as data
@@ -593,69 +1131,105 @@ static void retransmit_callback(void *ptr)
     //Add backpressure meta data to the header. All these meta data can be overwritten by the extender
     i->hdr.bcp_backpressure = bcp_queue_length(&c->packet_queue); 
     i->hdr.delay = i->hdr.delay + clock_time() - i->hdr.lastProcessTime;
-    i->hdr.lastProcessTime = i->hdr.lastProcessTime;
+    //A retransmission only adds the time elapsed since this one
+    i->hdr.lastProcessTime = clock_time();
 
     //Notify the extender
     if(c->ce != NULL && c->ce->beforeSendingData != NULL){
              struct bcp_queue_item * checkItm = c->ce->beforeSendingData(c, i);
              if(checkItm == NULL){
                   PRINTF("DEBUG: Aborting sending packet based on the extender result \n");
-                  setBusy(c, false, "send_packet");
-                  
-                  if(ctimer_expired(&c->beacon_timer)){
-                    clock_time_t time = BEACON_TIME;
-                    ctimer_set(&c->beacon_timer, time, send_beacon, c);
-                  }
+                  schedule_beacon(c);
                   
-                  retransmit_callback(c);
-                  return;
+                  //Wait for the extender (e.g. a new energy budget) before trying again
+                  c->send_blocked = BCP_BLOCKED_EXTENDER;
+                  schedule_send(c);
+                  return false;
              }else{
                  i = checkItm;
              }
     }
 
-    //Copy the data to the packetbuf
-    packetbuf_set_datalen(i->hdr.packet_length);
-    memcpy(packetbuf_dataptr(),i, i->hdr.packet_length);
-
-     //Remove pointers
-    struct bcp_queue_item* pI = packetbuf_dataptr();
-    pI->next = NULL;
-
-    c->tx_attempts += 1;
+    //A new packet takes a slot of the window and a sequence number
+    if(f == NULL){
+        f = free_inflight(c);
+        f->item = i;
+        f->seq = neigh->tx_seq++;
+        f->attempts = 0;
+        f->first = clock_time();
+        rimeaddr_copy(&f->neighbor, neighborAddr);
+        //Packets waiting for their ACK must not be fused
+        bcp_queue_group_remove(&c->packet_queue, i);
+        
+        //Decrease neighbor weight until the ACK is received, once per packet
+        neigh->backpressure += 5;
+        routingtable_changed(&c->routing_table, neigh);
+    }
     
-    struct routingtable_item* neigh = routing_table_find(&c->routing_table, neighborAddr);
-    neigh->backpressure += 5; //Decrease neighbor weight if the ACK not received 
-
-    PRINTF("DEBUG: Sending a data packet to node[%d].[%d] (Origin: [%d][%d]), BC=%d,len=%d, data[0]=%x \n", 
+    if(f->attempts < 0xff)
+        f->attempts++;
+    f->sent = clock_time();
+    //Back off, up to RETX_MAX_TIME between two transmissions
+    backoff = retransmission_timeout(neigh);
+    backoff = f->attempts < RETX_MAX_TIME / backoff ? backoff * f->attempts : RETX_MAX_TIME;
+    f->deadline = f->sent + backoff;
+
+    //Encode the packet into the packetbuf, local fields such as the list pointer are not sent
+    packetbuf_set_datalen(encode_data_packet(c, i, f->seq));
+
+    PRINTF("DEBUG: Sending data packet seq=%d (attempt %d) to node[%d].[%d] (Origin: [%d][%d]), BC=%d,len=%d, data[0]=%x \n", 
+            f->seq,
+            f->attempts,
             neighborAddr->u8[0], 
             neighborAddr->u8[1],
-            pI->hdr.origin.u8[0],
-            pI->hdr.origin.u8[1],
-            pI->hdr.bcp_backpressure,
-            pI->hdr.packet_length,
-            pI->data[0]);
+            i->hdr.origin.u8[0],
+            i->hdr.origin.u8[1],
+            i->hdr.bcp_backpressure,
+            packetbuf_datalen(),
+            i->data[0]);
 
      
-     //Send the data packet via the broadcast channel
-    broadcast_send(&c->broadcast_conn);
+     //Send the data packet via the broadcast channel. If the channel refuses 
+     //it, it is sent again at its deadline like a packet whose ACK was lost
+    if(!broadcast_send(&c->broadcast_conn)){
+        PRINTF("ERROR: Data packet seq=%d could not be sent\n", f->seq);
+        schedule_send(c);
+        return false;
+    }
+    
+    //The neighbors overhear the queue length carried by the data packet
+    c->advertised_queuelog = i->hdr.bcp_backpressure;
+    c->advertised = true;
 
     //Notify the extender
     if(c->ce != NULL && c->ce->afterSendingData != NULL)
                     c->ce->afterSendingData(c, i);
 
     
-    // Resend the send data timer
-    retransmit_callback(c);
-   
-    
+ 
+    // Schedule the next packet
+    schedule_send(c);
+    return true;
 }
  /**
   * Sends an ACK to the given neighbor.
   * @param bc the BCP connection.
   * @param to the rime address of the neighbor
+  * @param seq the sequence number of the acknowledged packet
+  */
+ static void send_ack(struct bcp_conn *bc, const rimeaddr_t *to, uint8_t seq){
+     tx_request(bc, BCP_TX_ACK, to, seq);
+ }
+ 
+ /**
+  * Builds and sends the ACK once the channel is free, see send_ack().
+  * @param bc the BCP connection.
+  * @param to the rime address of the neighbor
+  * @param seq the sequence number of the acknowledged packet
+  * @return true if the ACK occupies the channel, false if the channel refused it; 
+  *         the sender then sends the packet again
   */
- static void send_ack(struct bcp_conn *bc, const rimeaddr_t *to){
+ static bool tx_ack(struct bcp_conn *bc, const rimeaddr_t *to, uint8_t seq){
     
      struct ack_msg *ack;
 
@@ -663,10 +1237,11 @@ static void retransmit_callback(void *ptr)
      packetbuf_set_datalen(sizeof(struct ack_msg));
      ack = packetbuf_dataptr();
      memset(ack, 0, sizeof(struct ack_msg));
+     ack->seq = seq;
      packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE,
                        PACKETBUF_ATTR_PACKET_TYPE_ACK);
      //We use a unicast channel to send ACKS
-     unicast_send(&bc->unicast_conn, to);
+     return unicast_send(&bc->unicast_conn, to) != 0;
  }
  
  /**
@@ -700,11 +1275,111 @@ static void retransmit_callback(void *ptr)
         }
  }
  
- static void setBusy(struct bcp_conn *bcp_conn, bool isBusy, char * sourceName){
+ /**
+  * \breif Asks for the channel to send a data packet, beacon, beacon request or ACK
+  * \param c the bcp connection
+  * \param type the transmission (BCP_TX_*)
+  * \param to the receiver of an ACK, NULL otherwise
+  * \param seq the sequence number acknowledged by an ACK
+  * 
+  *      The transmission starts right away if the channel is free. Otherwise 
+  *      it waits in the pending list until the current one is done, see tx_done().
+  *      A data packet, beacon or beacon request is pending once at most since 
+  *      it is built when it is sent. A full list drops the transmission; the 
+  *      sender of a data packet whose ACK is dropped sends it again.
+  */
+ static void tx_request(struct bcp_conn *c, uint8_t type, const rimeaddr_t *to, uint8_t seq){
+     struct bcp_tx_op op;
+     uint8_t k;
      
-     bcp_conn->busy = isBusy;
-     PRINTF("DEBUG: Changing BCP busy flag to %d. Called from %s\n", isBusy, sourceName);
-}
+     op.type = type;
+     op.seq = seq;
+     if(to != NULL)
+         rimeaddr_copy(&op.to, to);
+     else
+         rimeaddr_copy(&op.to, &rimeaddr_null);
+     
+     if(c->tx_state == BCP_TX_IDLE && c->tx_pending_count == 0){
+         tx_run(c, &op);
+         //It may have asked for another transmission without occupying the channel
+         if(c->tx_state == BCP_TX_IDLE && c->tx_pending_count > 0)
+             tx_done(c);
+         return;
+     }
+     
+     if(type != BCP_TX_ACK)
+         for(k = 0; k < c->tx_pending_count; k++)
+             if(c->tx_pending[k].type == type)
+                 return;
+     
+     if(c->tx_pending_count == BCP_TX_PENDING){
+         PRINTF("ERROR: Too many pending transmissions, dropping type=%d\n", type);
+         return;
+     }
+     
+     PRINTF("DEBUG: The channel is busy (state=%d), transmission type=%d is pending\n", c->tx_state, type);
+     c->tx_pending[c->tx_pending_count++] = op;
+ }
+ 
+ /**
+  * \breif Builds and sends the given transmission
+  * \param c the bcp connection
+  * \param op the transmission
+  * 
+  *      The channel stays free if nothing has been sent, e.g. a suppressed 
+  *      beacon or a transmission refused by Rime; no sent callback follows then.
+  */
+ static void tx_run(struct bcp_conn *c, struct bcp_tx_op *op){
+     bool sent = false;
+     
+     //Set first, the MAC may report the end of the transmission before returning
+     c->tx_state = op->type;
+     switch(op->type){
+         case BCP_TX_DATA:
+             sent = tx_data(c);
+             break;
+         case BCP_TX_BEACON:
+             sent = tx_beacon(c);
+             break;
+         case BCP_TX_BEACON_REQUEST:
+             sent = tx_beacon_request(c);
+             break;
+         case BCP_TX_ACK:
+             sent = tx_ack(c, &op->to, op->seq);
+             break;
+     }
+     
+     if(!sent)
+         c->tx_state = BCP_TX_IDLE;
+ }
+ 
+ /**
+  * \breif Frees the channel and runs the pending transmissions, ACKs first, 
+  *      until one of them occupies the channel
+  * \param c the bcp connection
+  */
+ static void tx_done(struct bcp_conn *c){
+     struct bcp_tx_op op;
+     uint8_t k, next;
+     
+     c->tx_state = BCP_TX_IDLE;
+     
+     while(c->tx_state == BCP_TX_IDLE && c->tx_pending_count > 0){
+         next = 0;
+         for(k = 0; k < c->tx_pending_count; k++)
+             if(c->tx_pending[k].type == BCP_TX_ACK){
+                 next = k;
+                 break;
+             }
+         
+         op = c->tx_pending[next];
+         c->tx_pending_count--;
+         for(k = next; k < c->tx_pending_count; k++)
+             c->tx_pending[k] = c->tx_pending[k + 1];
+         
+         tx_run(c, &op);
+     }
+ }
  
  /**
  * Triggered by the check timer to check the current condition of BCP. 
@@ -722,10 +1397,8 @@ static void retransmit_callback(void *ptr)
 */
 
     //For Sink, check the beacon timer
-    if(c->isSink && ctimer_expired(&c->beacon_timer)){
-            clock_time_t time = BEACON_TIME;
-            ctimer_set(&c->beacon_timer, time, send_beacon, c);
-     }
+    if(c->isSink)
+        schedule_beacon(c);
 
     //Reset the check timer again - infinite loop 
     if(ctimer_expired(&c->check_timer)) {
@@ -740,7 +1413,26 @@ static void retransmit_callback(void *ptr)
 void bcp_open(struct bcp_conn *c, uint16_t channel,
               const struct bcp_callbacks *callbacks)
 {
+    uint8_t k;
+    
     PRINTF("DEBUG: Opening a bcp connection\n");
+    
+    //Find a free slot for the state of the connection
+    for(k = 0; k < BCP_MAX_CONNECTIONS; k++)
+        if(connections[k] == NULL || connections[k] == c)
+            break;
+    if(k == BCP_MAX_CONNECTIONS){
+        PRINTF("ERROR: Too many BCP connections, the connection is not opened\n");
+        c->isOpen = false;
+        return;
+    }
+    connections[k] = c;
+    c->index = k;
+    c->channel = channel;
+    c->acks = 0;
+    c->sink_intake = c->sink_slot_intake = c->sink_load = 0;
+    c->sink_slot_start = clock_time();
+    
     //Set the end user callback function
     c->cb = callbacks;
     //Set the default extender interface 
@@ -751,6 +1443,20 @@ void bcp_open(struct bcp_conn *c, uint16_t channel,
     LIST_STRUCT_INIT(c, routing_table_list);
     c->isOpen = true;
     
+    //No packet is waiting for an ACK
+    memset(c->inflight, 0, sizeof(c->inflight));
+    c->origin_seq = random_rand();
+    
+    //No packet has been received yet
+    memset(c->recent, 0, sizeof(c->recent));
+    c->recent_next = 0;
+    
+    //Beacons start at the shortest interval
+    c->beacon_interval = BEACON_TIME;
+    c->advertised_queuelog = 0;
+    c->advertised = false;
+    c->beacons_sent = c->beacons_suppressed = 0;
+    
     //Initialize nested components
     routing_table_init(c);
     weight_estimator_init(c);
@@ -767,16 +1473,15 @@ void bcp_open(struct bcp_conn *c, uint16_t channel,
     unicast_open(&c->unicast_conn, channel + 1, &unicast_callbacks);
     channel_set_attributes(channel + 1, attributes);
    
+    //Nothing is being sent yet
+    c->tx_state = BCP_TX_IDLE;
+    c->tx_pending_count = 0;
+    
     //Broadcast the first beacon
     send_beacon(c);
    
-    // Reset the send data timer
-    
-    //Make sure the send_timer is still alive. Otherwise, start it
-    if(!c->isSink && ctimer_expired(&c->send_timer)) {
-      clock_time_t time = SEND_TIME_DELAY;
-      ctimer_set(&c->send_timer, time, send_packet, c);
-    }
+    //The send timer is started by the first packet
+    c->send_blocked = 0;
      
     
     if(ctimer_expired(&c->beacon_timer)) {
@@ -797,11 +1502,18 @@ void bcp_close(struct bcp_conn *c){
   //Clear both routing table and packet queue
   routingtable_clear(&c->routing_table);
   bcp_queue_clear(&c->packet_queue);
+  memset(c->inflight, 0, sizeof(c->inflight));
+  memset(c->recent, 0, sizeof(c->recent));
+  c->tx_state = BCP_TX_IDLE;
+  c->tx_pending_count = 0;
   
   //Stop the timers
   stopTimers(c);
+  ctimer_stop(&c->routing_table.forwardable_timer);
   
   c->isOpen = false;
+  if(connections[c->index] == c)
+      connections[c->index] = NULL;
  
 }
 
@@ -810,7 +1522,6 @@ int bcp_send(struct bcp_conn *c){
     int result = 0;
     int maxSize = MAX_USER_PACKET_SIZE;
     
-     setBusy(c, true, "bcp_send");
     //Check the length of the packet
     if(packetbuf_datalen()> maxSize){
         PRINTF("ERROR: Packet cannot be sent. Data length is bigger than maximum packet size\n");
@@ -822,10 +1533,7 @@ int bcp_send(struct bcp_conn *c){
     PRINTF("DEBUG: Receiving user request to send a data packet \n");
     
     if(qi != NULL){
-        // Set the origin of the packet
-        rimeaddr_copy(&(qi->hdr.origin), &rimeaddr_node_addr);
-        qi->hdr.delay = 0;
-        qi->hdr.lastProcessTime = clock_time();
+        //The origin, delay and processing time are set by push_packet_to_queue
         // We have data to send, stop beaconing
         
         result = 1;
@@ -833,17 +1541,35 @@ int bcp_send(struct bcp_conn *c){
         packet_dropped(c);
     }
     
-    setBusy(c, false, "bcp_send");
-
+    //Start the send timer if it is idle
+    if(result)
+        schedule_send(c);
 
     return result;
 }
 
+void bcp_wakeup(struct bcp_conn *c){
+    c->send_blocked = 0;
+    schedule_send(c);
+}
+
 void bcp_set_sink(struct bcp_conn *c, bool isSink){
     
     c->isSink = isSink;
     
+    //A sink is one hop away from itself
+    if(hop_counter_update(c))
+        reset_beacon(c);
+    
     if(c->isSink == true){
+        //The load counts from now on
+        c->sink_slot_intake = c->sink_load = 0;
+        c->sink_slot_start = clock_time();
+        
+#if SINK_OUTPUT_BINARY
+        sink_output_init();
+#endif
+        
         PRINTF("DEBUG: This node is set as a sink \n");
         // Start beaconing
         if(ctimer_expired(&c->beacon_timer)){
@@ -854,5 +1580,18 @@ void bcp_set_sink(struct bcp_conn *c, bool isSink){
    
 }
 
+uint16_t bcp_backlog(struct bcp_conn *c){
+    uint16_t backlog;
+    
+    if(!c->isSink)
+        return bcp_queue_length(&c->packet_queue);
+    
+    sink_load_update(c);
+    backlog = c->sink_load / (16 * SINK_LOAD_DIV);
+    if(backlog > MAX_PACKET_QUEUE_SIZE)
+        backlog = MAX_PACKET_QUEUE_SIZE;
+    return backlog;
+}
+
 
 
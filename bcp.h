@@ -6,12 +6,15 @@
 #ifndef __BCP_H__
 #define __BCP_H__
 
+struct bcp_conn;
+
 #include <stdbool.h>
 #include "bcp-config.h"
 #include "bcp_routing_table.h"
 #include "bcp_queue.h"
 #include "bcp_extend.h"
 #include "bcp_weight_estimator.h"
+#include "hop_counter.h"
 
 
 #define BCP_ATTRIBUTES 	{ PACKETBUF_ADDR_ERECEIVER,     PACKETBUF_ADDRSIZE }, \
@@ -46,6 +49,87 @@ struct bcp_callbacks {
   void (* dropped)(struct bcp_conn *c);
 };
 
+/**
+ * \brief      A data packet sent and waiting for its ACK
+ */
+struct bcp_inflight {
+  //The packet in the queue, NULL if the entry is free
+  struct bcp_queue_item *item;
+  //The neighbor the packet is sent to
+  rimeaddr_t neighbor;
+  //Time at which the packet was last sent
+  clock_time_t sent;
+  //Time at which the packet is sent again if no ACK has been received
+  clock_time_t deadline;
+  //Sequence number of the packet, echoed by the ACK
+  uint8_t seq;
+  //Number of times the packet has been sent
+  uint8_t attempts;
+  //Time at which the packet was first sent
+  clock_time_t first;
+};
+
+/**
+ * \brief      A data packet recently received, to recognize its retransmissions
+ *             and its copies sent along other paths
+ */
+struct bcp_recent {
+  //The origin of the packet, rimeaddr_null if the entry is free
+  rimeaddr_t origin;
+  //Sequence number given to the packet by its origin
+  uint16_t origin_seq;
+  //The neighbor which sent the packet
+  rimeaddr_t from;
+  //Sequence number given to the packet by that neighbor
+  uint8_t seq;
+  //Time at which the packet was received
+  clock_time_t heard;
+};
+
+//Transmission occupying the channel (tx_state), see tx_request() in bcp.c
+#define BCP_TX_IDLE           0
+#define BCP_TX_DATA           1
+#define BCP_TX_BEACON         2
+#define BCP_TX_BEACON_REQUEST 3
+#define BCP_TX_ACK            4
+
+/**
+ * \brief      A transmission waiting for the channel to be free
+ */
+struct bcp_tx_op {
+  //BCP_TX_*
+  uint8_t type;
+  //Sequence number acknowledged by an ACK
+  uint8_t seq;
+  //Receiver of an ACK
+  rimeaddr_t to;
+};
+
+//Reasons for which sending waits for an event, see bcp_wakeup()
+#define BCP_BLOCKED_NO_NEIGHBOR 1
+#define BCP_BLOCKED_EXTENDER    2
+
+/**
+ * \brief Declares a memory pool for every BCP connection, see MEMB()
+ * 
+ *      Components which allocate records for a connection (queue items, 
+ *      routing table records) declare their pools with this macro, and 
+ *      name##_init(c) returns the initialized pool of the connection c.
+ */
+#define BCP_MEMB(name, structure, number) \
+        static char name##_count[BCP_MAX_CONNECTIONS][number]; \
+        static structure name##_mem[BCP_MAX_CONNECTIONS][number]; \
+        static struct memb name[BCP_MAX_CONNECTIONS]; \
+        static struct memb * name##_init(struct bcp_conn *c){ \
+            struct memb *m = &name[c->index]; \
+            m->size = sizeof(structure); \
+            m->num = number; \
+            m->count = name##_count[c->index]; \
+            m->mem = (void *)name##_mem[c->index]; \
+            memb_init(m); \
+            return m; \
+        }
+
 struct bcp_conn {
   //Used to broadcast user data packets and beacons
   struct broadcast_conn broadcast_conn;
@@ -58,9 +142,21 @@ struct bcp_conn {
   
   //Component Extender - SPI
   const struct bcp_extender * ce;
+  
+  //Slot of the connection among the opened ones (< BCP_MAX_CONNECTIONS). 
+  //Components keep their state of the connection at this index.
+  uint8_t index;
+  //First channel of the connection, see bcp_open()
+  uint16_t channel;
+  
+  //Hop counter of the connection
+  struct hop_counter hop_counter;
 
-  //Flag to indicate whether the bcp channel is busy or not
-  bool busy;
+  //Transmission occupying the channel (BCP_TX_*), BCP_TX_IDLE if it is free
+  uint8_t tx_state;
+  //Transmissions waiting for the channel, in order of request
+  struct bcp_tx_op tx_pending[BCP_TX_PENDING];
+  uint8_t tx_pending_count;
   
   //Flag to indicate whether the node is sink or not
   bool isSink;
@@ -88,15 +184,51 @@ struct bcp_conn {
   LIST_STRUCT(routing_table_list);
   struct routingtable routing_table;
   
-  //Counts tx attempts achieved so far to send the current packet 
-  uint16_t tx_attempts;
+  //Data packets waiting for their ACK (window)
+  struct bcp_inflight inflight[BCP_TX_INFLIGHT];
+  
+  //Why the last send attempt failed (BCP_BLOCKED_*), zero if it did not
+  uint8_t send_blocked;
+  //Expiration time of the send timer
+  clock_time_t send_at;
+  
+  //Sequence number of the next packet generated by this node, the packets 
+  //built by the extender (e.g. fusion packets) included
+  uint16_t origin_seq;
+  
+  //Data packets received lately (ring)
+  struct bcp_recent recent[BCP_RECENT_SIZE];
+  uint8_t recent_next;
+  
+  //Current beacon interval (trickle)
+  clock_time_t beacon_interval;
+  //Queue length last advertised to the neighbors by a beacon or a data packet
+  uint16_t advertised_queuelog;
+  //Set when a data packet advertised the queue length since the last beacon
+  bool advertised;
+  //Number of beacons sent and skipped because the neighbors were up to date
+  uint16_t beacons_sent;
+  uint16_t beacons_suppressed;
+  //Number of ACKs received, see returnACK()
+  int acks;
+  
+  //Sink only: data packets taken in since the connection was opened
+  uint32_t sink_intake;
+  //Sink only: data packets taken in during the current time slot, and its start
+  uint16_t sink_slot_intake;
+  clock_time_t sink_slot_start;
+  //Sink only: decayed number of data packets taken in per time slot, times 16
+  uint16_t sink_load;
   
   
 };
 
 
-int returnACK();
-void resetACK();
+/**
+ * \return the number of ACKs received by the given connection since the last resetACK()
+ */
+int returnACK(struct bcp_conn *c);
+void resetACK(struct bcp_conn *c);
 
 /**
 * \brief	Opens a bcp connection.
@@ -105,10 +237,14 @@ void resetACK();
 * \param cb   A pointer to the callbacks used for this connection
 *		
 *	      This function opens a bcp connection on the
-*             specified channel. The BCP connection will use two channel ports 
-*            (channel, and channel+1). The callbacks are called when a
+*             specified channel. The BCP connection will use four channel ports 
+*            (channel to channel+3, see also the DAG routing table; channel+2 
+*             is no longer used). The callbacks are called when a
 *             packet is received (check \ref "struct bcp_callbacks").
 *
+*             Up to BCP_MAX_CONNECTIONS connections can be open at the same time;
+*             c stays closed if there are already as many.
+*
 */
 void bcp_open(struct bcp_conn *c, uint16_t channel,
               const struct bcp_callbacks *callbacks
@@ -147,4 +283,27 @@ int bcp_send(struct bcp_conn *c);
  */
 void bcp_set_sink(struct bcp_conn *c, bool isSink);
 
+/**
+ * \brief The backlog the node advertises to its neighbors
+ * \param c the opened bcp connection
+ * \return the queue length, or for a sink the virtual backlog of its load 
+ * 
+ *      Any number of nodes can be sinks; a data packet is delivered by the 
+ *      first sink it reaches. Sinks advertise a backlog which grows with the 
+ *      number of packets they take in (see SINK_LOAD_DIV), so the traffic 
+ *      spreads among them instead of crowding around one.
+ */
+uint16_t bcp_backlog(struct bcp_conn *c);
+
+/**
+ * \brief Tells BCP that it may be able to send again
+ * \param c the opened bcp connection
+ * 
+ *      BCP does not poll for packets to send. When sending stops because 
+ *      there is no neighbor to send to or the extender refuses to send (e.g.
+ *      no energy budget), it waits for a routing update or a call of this 
+ *      function, for instance when a new energy budget is available.
+ */
+void bcp_wakeup(struct bcp_conn *c);
+
 #endif /* __BCP_H__ */
\ No newline at end of file
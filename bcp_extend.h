@@ -43,6 +43,36 @@ struct bcp_extender{
    * Called by BCP when a user requests BCP to send a new data packet (i.e. calling fusion 'bcp_send').
    */
   void (*onUserSendRequest)(struct bcp_conn *c, struct bcp_queue_item* itm);
+  
+  /**
+   * Called by BCP when a data packet is encoded for the radio (see \ref bcp_wire.h).
+   * 
+   * \return the extension bits (BCP_WIRE_EXT_BITS wide) sent with the packet.
+   */
+  uint8_t (*encodeData)(struct bcp_conn *c, struct bcp_queue_item* itm);
+  
+  /**
+   * Called by BCP when a received data packet has been decoded into itm, with
+   * the extension bits sent by encodeData. Called before 'onReceivingData'.
+   */
+  void (*decodeData)(struct bcp_conn *c, struct bcp_queue_item* itm, uint8_t ext);
+  
+  /**
+   * Called by a sink to describe a delivered data packet for the binary sink
+   * output (see \ref sink_output.h): the number of packets it stands for and 
+   * its group. Both default to 1 and 0.
+   */
+  void (*describeData)(struct bcp_conn *c, struct bcp_queue_item* itm, uint16_t *count, uint8_t *group);
+  
+  /**
+   * Called by BCP before a received data packet or a packet of the user is 
+   * added to the queue, after 'onReceivingData' or 'onUserSendRequest'. The
+   * extender may merge it into a packet already queued, in which case itm 
+   * is not queued.
+   * 
+   * \return the queued packet itm has been merged into, or NULL to queue itm.
+   */
+  struct bcp_queue_item* (*mergeData)(struct bcp_conn *c, struct bcp_queue_item* itm);
 };
 
 #endif	/* BCP_EXTENDER_H */
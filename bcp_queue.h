@@ -10,6 +10,10 @@
 #include "net/packetbuf.h"
 #include "bcp-config.h"
 
+#define BCP_QUEUE_NO_GROUP 0xff
+
+struct bcp_queue_item;
+
 /**
  * \brief      A structure defines a bcp queue
  *             Every BCP connection has one queue which is used to store user packets
@@ -22,6 +26,22 @@ struct bcp_queue {
   struct memb *memb;
   //Parent BCP connection for the queue
   void* bcp_connection;
+  //Classifies the queued items into groups, NULL if the items are not grouped
+  uint8_t (* group_of)(struct bcp_queue_item *i);
+  //First item (memb block) and number of items of every group
+  uint8_t group_head[BCP_QUEUE_GROUPS];
+  uint8_t group_count[BCP_QUEUE_GROUPS];
+  //Group of every memb block and next block of the same group
+  uint8_t group[MAX_PACKET_QUEUE_SIZE];
+  uint8_t group_next[MAX_PACKET_QUEUE_SIZE];
+#if BCP_QUEUE_ARRAY
+  //Ring of the queued items, the first item is slots[head]
+  struct bcp_queue_item *slots[MAX_PACKET_QUEUE_SIZE];
+  //Ring slot of the item stored in every memb block
+  uint8_t slot_of[MAX_PACKET_QUEUE_SIZE];
+  uint8_t head;
+  uint8_t count;
+#endif
 };
 
 /**
@@ -36,6 +56,16 @@ struct bcp_packet_header {
      * The addressed of the node which generated the packet
      */
     rimeaddr_t origin;
+    /**
+     * The sequence number given to the packet by its origin. Together with the
+     * origin, it identifies the packet.
+     */
+    uint16_t origin_seq;
+    /**
+     * Non-zero if the packet merges the packets of other origins (a fusion 
+     * packet). The extender sends it along with the packet.
+     */
+    uint8_t merged;
     /**
      * The length of the packet
      */
@@ -112,6 +142,32 @@ struct bcp_queue_item * bcp_queue_element(struct bcp_queue *s, uint16_t index);
  */
 struct bcp_queue_item * bcp_queue_push(struct bcp_queue *s, struct bcp_queue_item *i);
 
+/**
+ * \brief Reserves a record for a new packet without adding it to the queue yet
+ * \param s the packet queue
+ * \return the reserved record, or NULL if the queue is full.
+ * 
+ *          The caller writes the packet straight into the returned record and
+ *          then calls bcp_queue_commit() to add it to the queue, or
+ *          bcp_queue_release() to give it back. This saves the copy made by
+ *          bcp_queue_push().
+ */
+struct bcp_queue_item * bcp_queue_reserve(struct bcp_queue *s);
+
+/**
+ * \brief Adds a record obtained from bcp_queue_reserve() to the queue
+ * \param s the packet queue
+ * \param i the reserved record, filled in by the caller
+ * \return the given record, now part of the queue.
+ */
+struct bcp_queue_item * bcp_queue_commit(struct bcp_queue *s, struct bcp_queue_item *i);
+
+/**
+ * \brief Gives back a record obtained from bcp_queue_reserve() which has not
+ *        been committed
+ */
+void bcp_queue_release(struct bcp_queue *s, struct bcp_queue_item *i);
+
 
 /**
  * \breif Removes the first packet from the packet queue
@@ -146,4 +202,50 @@ int bcp_queue_length(struct bcp_queue *s);
  */
 void bcp_queue_clear(struct bcp_queue *s);
 
+/**
+ * \return the index of the memb block holding the given queue item, or -1 if
+ * the item has not been allocated from the memb of the queue.
+ */
+int bcp_queue_block(struct bcp_queue *s, struct bcp_queue_item *i);
+
+/**
+ * \breif Sets the function used to classify the queued items into groups
+ * 
+ * \param s the packet queue, which must be empty
+ * \param group_of returns the group (0..BCP_QUEUE_GROUPS-1) of an item or
+ *        BCP_QUEUE_NO_GROUP. It is called once, when the item is pushed.
+ * 
+ *      Groups let a component (e.g. fusion) reach the items it is interested
+ *      in without walking the whole queue.
+ */
+void bcp_queue_group_init(struct bcp_queue *s, uint8_t (* group_of)(struct bcp_queue_item *i));
+
+/**
+ * \breif Adds a newly pushed item to its group. Called by the queue backends.
+ */
+void bcp_queue_group_add(struct bcp_queue *s, struct bcp_queue_item *i);
+
+/**
+ * \breif Removes an item from its group. Called by the queue backends before
+ *        releasing the item.
+ */
+void bcp_queue_group_remove(struct bcp_queue *s, struct bcp_queue_item *i);
+
+/**
+ * \return the most recently pushed item of the given group, NULL if the group
+ * is empty.
+ */
+struct bcp_queue_item * bcp_queue_group_top(struct bcp_queue *s, uint8_t g);
+
+/**
+ * \return the item of the same group pushed before the given one, NULL if the
+ * given item is the last one of its group.
+ */
+struct bcp_queue_item * bcp_queue_group_next(struct bcp_queue *s, struct bcp_queue_item *i);
+
+/**
+ * \return the number of items in the given group
+ */
+uint8_t bcp_queue_group_length(struct bcp_queue *s, uint8_t g);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,226 @@
+/**
+ * \file
+ *         Array implementation of bcp_queue (see \ref bcp_queue.h). The queue
+ *         items are kept in a ring of MAX_PACKET_QUEUE_SIZE slots together
+ *         with their count, so bcp_queue_length() and bcp_queue_element()
+ *         run in constant time whatever the backlog is. The slot of every
+ *         item is recorded by memb block, which makes bcp_queue_next()
+ *         constant time as well.
+ *         The current scheduling is LIFO, as in bcp_queue_lifo.c.
+ *
+ *         Requires BCP_QUEUE_ARRAY to be set to 1 (see bcp-config.h).
+ */
+#include "bcp_queue.h"
+#include "bcp.h"
+#include <stdbool.h>
+#include <string.h>
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "net/rime.h"
+
+#if !BCP_QUEUE_ARRAY
+#error "bcp_queue_array.c requires BCP_QUEUE_ARRAY=1"
+#endif
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define NO_SLOT 0xff
+
+static void bcp_queue_print(struct bcp_queue *s);
+
+/**
+ * \return the ring slot of the given logical position
+ */
+static uint8_t slot(struct bcp_queue *s, uint16_t index){
+    return (s->head + index) % MAX_PACKET_QUEUE_SIZE;
+}
+
+/**
+ * \return the logical position of the given item, or -1 if it is not queued
+ */
+static int position_of(struct bcp_queue *s, struct bcp_queue_item *i){
+    int b = bcp_queue_block(s, i);
+    uint16_t p;
+
+    if(b < 0 || s->slot_of[b] == NO_SLOT || s->slots[s->slot_of[b]] != i)
+        return -1;
+    p = (s->slot_of[b] + MAX_PACKET_QUEUE_SIZE - s->head) % MAX_PACKET_QUEUE_SIZE;
+    return p < s->count ? p : -1;
+}
+
+/**
+ * \breif Stores the given item in the given ring slot
+ */
+static void place(struct bcp_queue *s, uint8_t sl, struct bcp_queue_item *i){
+    int b = bcp_queue_block(s, i);
+
+    s->slots[sl] = i;
+    if(b >= 0)
+        s->slot_of[b] = sl;
+}
+
+void bcp_queue_init(void *c){
+    //Setup BCP
+    struct bcp_conn * bcp_c = (struct bcp_conn *) c;
+    bcp_c->packet_queue.list = &(bcp_c->packet_queue_list);
+    bcp_c->packet_queue.bcp_connection = c;
+    
+    //The list is not used by this backend but kept initialized for the other components
+    list_init(bcp_c->packet_queue_list);
+    bcp_queue_group_init(&bcp_c->packet_queue, NULL);
+    bcp_c->packet_queue.head = 0;
+    bcp_c->packet_queue.count = 0;
+    memset(bcp_c->packet_queue.slot_of, NO_SLOT, sizeof(bcp_c->packet_queue.slot_of));
+    PRINTF("DEBUG: Bcp Queue has been initialized \n");
+    
+    /**
+     * The memory allocation of the queue items is still performed by another
+     * component (see bcp_queue_allocator.h), the ring only stores pointers.
+     */
+}
+
+struct bcp_queue_item * bcp_queue_top(struct bcp_queue *s){
+    if(s->count == 0)
+        return NULL;
+    return s->slots[s->head];
+}
+
+struct bcp_queue_item * bcp_queue_next(struct bcp_queue *s, struct bcp_queue_item *i){
+    int p = position_of(s, i);
+
+    if(p < 0)
+        return NULL;
+    return bcp_queue_element(s, p + 1);
+}
+
+struct bcp_queue_item * bcp_queue_element(struct bcp_queue *s, uint16_t index){
+    if(index >= s->count)
+        return NULL;
+    return s->slots[slot(s, index)];
+}
+
+void bcp_queue_remove(struct bcp_queue *s, struct bcp_queue_item *i){
+    int p = position_of(s, i);
+    int b = bcp_queue_block(s, i);
+    uint16_t k;
+
+    PRINTF("DEBUG: Removing an item from the packet queue\n");
+    //Null is not allowed here
+    if(i == NULL || p < 0){
+        PRINTF("ERROR: Passed queue item record cannot be removed from the packet queue\n");
+        return;
+    }
+
+    //Close the gap by moving the shorter side of the ring
+    if(p < s->count / 2){
+        for(k = p; k > 0; k--)
+            place(s, slot(s, k), s->slots[slot(s, k - 1)]);
+        s->head = slot(s, 1);
+    }else{
+        for(k = p; k + 1 < s->count; k++)
+            place(s, slot(s, k), s->slots[slot(s, k + 1)]);
+    }
+    s->count--;
+
+    s->slot_of[b] = NO_SLOT;
+    bcp_queue_group_remove(s, i);
+    memb_free(s->memb, i);
+    
+    // bcp_queue_print(s);
+}
+
+void bcp_queue_pop(struct bcp_queue *s){
+    PRINTF("DEBUG: Removing the first item from the packet queue\n");
+    struct bcp_queue_item *  i = bcp_queue_top(s);
+    bcp_queue_remove(s, i);
+   // bcp_queue_print(s);
+}
+
+int bcp_queue_length(struct bcp_queue *s){
+    return s->count;
+}
+
+struct bcp_queue_item * bcp_queue_reserve(struct bcp_queue *s){
+    struct bcp_queue_item * newRow;
+    
+    //Make sure the queue is not full
+    if(s->count + 1 > MAX_PACKET_QUEUE_SIZE){
+        PRINTF("ERROR: Packet Queue is full, a new packet will be dropped \n");
+        return NULL;
+    }
+    
+    // Allocate a memory block for the new record
+    newRow = memb_alloc(s->memb);
+  
+    if(newRow == NULL || bcp_queue_block(s, newRow) < 0) {
+         PRINTF("ERROR: memory cannot be allocated for a bcp_queue_item record. Queue length=%d \n", s->count);
+         if(newRow != NULL)
+             memb_free(s->memb, newRow);
+         return NULL;
+    }
+    
+    return newRow;
+}
+
+struct bcp_queue_item * bcp_queue_commit(struct bcp_queue *s, struct bcp_queue_item *newRow){
+    if(newRow == NULL)
+        return NULL;
+    
+    //Sets the queue fields of the new record
+    newRow->next = NULL;
+    newRow->hdr.bcp_backpressure = 0;
+    
+    //LIFO: the new row becomes the first item
+    s->head = slot(s, MAX_PACKET_QUEUE_SIZE - 1);
+    place(s, s->head, newRow);
+    s->count++;
+    bcp_queue_group_add(s, newRow);
+    
+    PRINTF("DEBUG: Pushing a new data packet to the packet queue\n");
+    
+    return newRow;
+}
+
+void bcp_queue_release(struct bcp_queue *s, struct bcp_queue_item *i){
+    PRINTF("DEBUG: Releasing a reserved queue item\n");
+    if(i != NULL)
+        memb_free(s->memb, i);
+}
+
+struct bcp_queue_item * bcp_queue_push(struct bcp_queue *s, struct bcp_queue_item *i){
+    //Copies the given item into a reserved record and queues it
+    struct bcp_queue_item * newRow = bcp_queue_reserve(s);
+    
+    if(newRow == NULL)
+        return NULL;
+    
+    memcpy(newRow, i, i->hdr.packet_length);
+    return bcp_queue_commit(s, newRow);
+}
+
+
+void bcp_queue_clear(struct bcp_queue *s){
+  //For every stored record
+  while(bcp_queue_top(s) != NULL) {
+    bcp_queue_pop(s);
+  }
+  
+  PRINTF("DEBUG: Packet Queue has been cleared\n");
+  
+}
+
+static void bcp_queue_print(struct bcp_queue *s){
+    #if DEBUG
+        uint16_t j;
+        for(j = 0; j < s->count; j++){
+            struct bcp_queue_item * i = bcp_queue_element(s, j);
+            printf("DEBUG: Queue item#%d=%p node[%d].[%d]\n", j, i, i->hdr.origin.u8[0], i->hdr.origin.u8[1]);
+        }
+    #endif
+}
@@ -0,0 +1,100 @@
+/**
+ * \file
+ *         Item groups of the packet queue (see \ref bcp_queue.h). Every group
+ *         is a singly linked list of memb block indexes kept next to the
+ *         queue, so the items themselves (and the packets sent over the air)
+ *         are not changed. The queue backends call bcp_queue_group_add() and
+ *         bcp_queue_group_remove() whenever they push or release an item.
+ */
+#include "bcp_queue.h"
+#include <string.h>
+#include "lib/memb.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define NO_BLOCK 0xff
+
+int bcp_queue_block(struct bcp_queue *s, struct bcp_queue_item *i){
+    int b;
+
+    if(i == NULL || s->memb == NULL || !memb_inmemb(s->memb, i))
+        return -1;
+    b = ((char *)i - (char *)s->memb->mem) / s->memb->size;
+    return b < MAX_PACKET_QUEUE_SIZE ? b : -1;
+}
+
+static struct bcp_queue_item * item_of(struct bcp_queue *s, uint8_t b){
+    if(b == NO_BLOCK)
+        return NULL;
+    return (struct bcp_queue_item *)((char *)s->memb->mem + b * s->memb->size);
+}
+
+void bcp_queue_group_init(struct bcp_queue *s, uint8_t (* group_of)(struct bcp_queue_item *i)){
+    s->group_of = group_of;
+    memset(s->group_head, NO_BLOCK, sizeof(s->group_head));
+    memset(s->group_count, 0, sizeof(s->group_count));
+    memset(s->group, BCP_QUEUE_NO_GROUP, sizeof(s->group));
+    memset(s->group_next, NO_BLOCK, sizeof(s->group_next));
+}
+
+void bcp_queue_group_add(struct bcp_queue *s, struct bcp_queue_item *i){
+    int b = bcp_queue_block(s, i);
+    uint8_t g;
+
+    if(s->group_of == NULL || b < 0)
+        return;
+    g = s->group_of(i);
+    if(g >= BCP_QUEUE_GROUPS)
+        return;
+
+    s->group[b] = g;
+    s->group_next[b] = s->group_head[g];
+    s->group_head[g] = b;
+    s->group_count[g]++;
+    PRINTF("DEBUG: Queue item %p added to group %d (%d items)\n", i, g, s->group_count[g]);
+}
+
+void bcp_queue_group_remove(struct bcp_queue *s, struct bcp_queue_item *i){
+    int b = bcp_queue_block(s, i);
+    uint8_t g, *link;
+
+    if(b < 0 || s->group[b] == BCP_QUEUE_NO_GROUP)
+        return;
+    g = s->group[b];
+
+    for(link = &s->group_head[g]; *link != NO_BLOCK; link = &s->group_next[*link]){
+        if(*link == b){
+            *link = s->group_next[b];
+            s->group_count[g]--;
+            break;
+        }
+    }
+    s->group[b] = BCP_QUEUE_NO_GROUP;
+    s->group_next[b] = NO_BLOCK;
+}
+
+struct bcp_queue_item * bcp_queue_group_top(struct bcp_queue *s, uint8_t g){
+    if(g >= BCP_QUEUE_GROUPS)
+        return NULL;
+    return item_of(s, s->group_head[g]);
+}
+
+struct bcp_queue_item * bcp_queue_group_next(struct bcp_queue *s, struct bcp_queue_item *i){
+    int b = bcp_queue_block(s, i);
+
+    if(b < 0 || s->group[b] == BCP_QUEUE_NO_GROUP)
+        return NULL;
+    return item_of(s, s->group_next[b]);
+}
+
+uint8_t bcp_queue_group_length(struct bcp_queue *s, uint8_t g){
+    if(g >= BCP_QUEUE_GROUPS)
+        return 0;
+    return s->group_count[g];
+}
@@ -30,6 +30,7 @@ void bcp_queue_init(void *c){
     bcp_c->packet_queue.bcp_connection = c;
     
     list_init(bcp_c->packet_queue_list);
+    bcp_queue_group_init(&bcp_c->packet_queue, NULL);
     PRINTF("DEBUG: Bcp Queue has been initialized \n");
     
     /**
@@ -72,6 +73,7 @@ void bcp_queue_remove(struct bcp_queue *s, struct bcp_queue_item *i){
    //Null is not allowed here
    if(i != NULL) {
     list_remove(*s->list, i);
+    bcp_queue_group_remove(s, i);
     memb_free(s->memb, i);
   }else{
        PRINTF("ERROR: Passed queue item record cannot be removed from the packet queue\n");
@@ -91,7 +93,7 @@ int bcp_queue_length(struct bcp_queue *s){
     return list_length(*s->list);
 }
 
-struct bcp_queue_item * bcp_queue_push(struct bcp_queue *s, struct bcp_queue_item *i){
+struct bcp_queue_item * bcp_queue_reserve(struct bcp_queue *s){
     struct bcp_queue_item * newRow;
     
     //Make sure the queue is not full
@@ -109,16 +111,21 @@ struct bcp_queue_item * bcp_queue_push(struct bcp_queue *s, struct bcp_queue_ite
          return NULL;
      }
     
+    return newRow;
+}
+
+struct bcp_queue_item * bcp_queue_commit(struct bcp_queue *s, struct bcp_queue_item *newRow){
+    if(newRow == NULL)
+        return NULL;
     
-    //Sets the fields of the new record
-    memcpy(newRow, i, i->hdr.packet_length);
+    //Sets the queue fields of the new record
     newRow->next = NULL;
     newRow->hdr.bcp_backpressure = 0;
-    newRow->hdr.packet_length = i->hdr.packet_length;   
     
     
     //Add the row to the queue
     list_push(*s->list, newRow);
+    bcp_queue_group_add(s, newRow);
     
     PRINTF("DEBUG: Pushing a new data packet to the packet queue\n");
     //if(newRow ->hdr.origin.u8[0] == 250)
@@ -128,6 +135,23 @@ struct bcp_queue_item * bcp_queue_push(struct bcp_queue *s, struct bcp_queue_ite
     
 }
 
+void bcp_queue_release(struct bcp_queue *s, struct bcp_queue_item *i){
+    PRINTF("DEBUG: Releasing a reserved queue item\n");
+    if(i != NULL)
+        memb_free(s->memb, i);
+}
+
+struct bcp_queue_item * bcp_queue_push(struct bcp_queue *s, struct bcp_queue_item *i){
+    //Copies the given item into a reserved record and queues it
+    struct bcp_queue_item * newRow = bcp_queue_reserve(s);
+    
+    if(newRow == NULL)
+        return NULL;
+    
+    memcpy(newRow, i, i->hdr.packet_length);
+    return bcp_queue_commit(s, newRow);
+}
+
 
 void bcp_queue_clear(struct bcp_queue *s){
   //For every stored record
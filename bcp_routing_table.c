@@ -19,9 +19,24 @@
 #define PRINTF(...)
 #endif
 
-//Timer for forwardable flag
+//Period of the forwardable timer
 clock_time_t time_fe = CLOCK_SECOND * SLOT_DURATION;
-struct ctimer forwardable_timer; 
+
+struct routingtable_item * routing_table_neighbor_first(struct routingtable *t){
+    return list_head(*t->list);
+}
+
+struct routingtable_item * routing_table_neighbor_next(struct routingtable *t, struct routingtable_item *i){
+    return list_item_next(i);
+}
+
+void routing_table_neighbor_link(struct routingtable *t, struct routingtable_item *i){
+    list_add(*t->list, i);
+}
+
+void routing_table_neighbor_unlink(struct routingtable *t, struct routingtable_item *i){
+    list_remove(*t->list, i);
+}
 
 /**
  * \breif updates the forwardable flag for all neighbors. 
@@ -37,6 +52,9 @@ void updateForwardable(void* v){
     
     struct routingtable_item *i = NULL;
    
+    //Forget the neighbors which are gone
+    if(routing_table_neighbor_purge(t) > 0)
+        hop_counter_update(bcp_c);
     
     //For each neighbor  
     for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
@@ -51,8 +69,10 @@ void updateForwardable(void* v){
 
         }
     }
+    //Weigh every neighbor again once per time slot
+    routingtable_invalidate(t);
     //Reset the timer
-    ctimer_set(&forwardable_timer, time_fe, updateForwardable, bcp_c);
+    ctimer_set(&t->forwardable_timer, time_fe, updateForwardable, bcp_c);
  }
 
 void routing_table_init(void *c){
@@ -62,8 +82,9 @@ void routing_table_init(void *c){
     bcp_c->routing_table.bcp_connection = c;
     //Init the list
     list_init(bcp_c->routing_table_list);
+    routing_table_best_init(&bcp_c->routing_table, NULL);
     //Start the forwardable timer
-    ctimer_set(&forwardable_timer, time_fe, updateForwardable, bcp_c);
+    ctimer_set(&bcp_c->routing_table.forwardable_timer, time_fe, updateForwardable, bcp_c);
 
     PRINTF("DEBUG: Bcp routing table has been initialized. length=%d \n", routingtable_length(&bcp_c->routing_table));
 }
@@ -72,7 +93,7 @@ struct routingtable_item* routing_table_find(struct routingtable *t,
                                const rimeaddr_t * addr){
      struct routingtable_item *i = NULL;
    
-    // Check for entry using binary search as number of records is usually very limited
+    // Check for entry using linear search as number of records is usually very limited (see bcp_routing_table_hash.c otherwise)
     for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
       if(rimeaddr_cmp(&(i->neighbor), addr))
         break;
@@ -88,30 +109,17 @@ int routing_table_update_queuelog(struct routingtable *t,
    
     i = routing_table_find(t, addr);
         
-    //No record for this neighbor address
+    //No record for this neighbor address, its hop count is not known yet
     if(i == NULL) {
-        // Allocate memory for the new record
-        i = memb_alloc(t->memb);
+        i = routing_table_neighbor_add(t, addr, 0);
 
         //Failed to allocate memory
         if(i == NULL) {
           return 0;
         }
-
-        // Set default attributes
-        i->next = NULL;
-        rimeaddr_copy(&(i->neighbor), addr);
-        i->backpressure = queuelog;
-        
-        
-        //Ask weight estimator to initialize its fields 
-        weight_estimator_record_init(i);
-        
-        //Insert the new record
-        list_add(*t->list, i);
-    }else{
-        i->backpressure = queuelog;
     }
+    i->backpressure = queuelog;
+    i->last_heard = clock_time();
         
     if ((int) queuelog < 0 || queuelog > MAX_PACKET_QUEUE_SIZE ){
         i->backpressure =  MAX_PACKET_QUEUE_SIZE;
@@ -128,6 +136,7 @@ int routing_table_update_queuelog(struct routingtable *t,
     PRINTF("DEBUG: Changing queuelog for node[%d].[%d]. Mark the node as unforwardable for the next %d time slot(s) \n"
             , addr->u8[0], addr->u8[1],  i->forwardable -1);
     }
+    routingtable_changed(t, i);
 
     print_routingtable(t);
     return 1;
@@ -143,9 +152,8 @@ int routingtable_length(struct routingtable *t)
 void routingtable_clear(struct routingtable *t){
     
    struct routingtable_item *i;
-   for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
-       list_remove(*t->list, i);
-       memb_free(t->memb, i);
+   while((i = list_head(*t->list)) != NULL) {
+       routing_table_neighbor_remove(t, i);
    }
    
    PRINTF("DEBUG: Routing table has been cleared\n");
@@ -153,11 +161,12 @@ void routingtable_clear(struct routingtable *t){
 
 
 void routingtable_clearForwardable(struct routingtable *t){
-   struct routingtable_item *i;
-   for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
+   struct routingtable_item *i, *next;
+   for(i = list_head(*t->list); i != NULL; i = next) {
+       //list_remove() clears the next pointer of the removed item
+       next = list_item_next(i);
        if(i->forwardable == 1){
-            list_remove(*t->list, i);
-            memb_free(t->memb, i);
+            routing_table_neighbor_remove(t, i);
        }
    } 
 }
@@ -165,23 +174,18 @@ void routingtable_clearForwardable(struct routingtable *t){
 
 rimeaddr_t* routingtable_find_routing( struct routingtable *t){
    
-   int largestWeight = -32768;
-   int neighborWeight;
-   struct routingtable_item * largestNeightbor = NULL;
+   struct routingtable_item * largestNeightbor;
    struct routingtable_item *i;
-   //For each neighbor stored 
-   for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
-       //If smallest weight variable is not yet set 
-       neighborWeight = weight_estimator_getWeight(t->bcp_connection, i);
-       //Has this neighbor smaller weight
-       //Temp Test
-       if(largestWeight <= neighborWeight ){//&& i->forwardable == 1){
-           largestWeight = neighborWeight;
-           largestNeightbor = i;
+   //Weigh every neighbor stored only when the best ones may be unknown
+   if(routing_table_best_invalid(t)){
+       routing_table_best_reset(t);
+       for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
+           routing_table_best_offer(t, i);
        }
    }
+   largestNeightbor = routing_table_best(t);
    //No result
-   if(largestNeightbor == NULL || largestWeight < 1)
+   if(largestNeightbor == NULL)
        return NULL;
   
    
@@ -202,27 +206,16 @@ int routing_table_update_hopCount(struct routingtable *t,
     
     //No record for this neighbor address
     if(i == NULL) {
-        // Allocate memory for the new record
-        i = memb_alloc(t->memb);
+        i = routing_table_neighbor_add(t, addr, hop_count);
 
         //Failed to allocate memory
         if(i == NULL) {
           return 0;
         }
-
-        // Set default attributes
-        i->next = NULL;
-        rimeaddr_copy(&(i->neighbor), addr);
-        i->backpressure = 0;
-        i->hop_count = hop_count;
-        //Ask weight estimator to initialize its fields 
-        weight_estimator_record_init(i);
-        
-        //Insert the new record
-        list_add(*t->list, i);
-    }else{
-        i->hop_count = hop_count;
     }
+    i->hop_count = hop_count;
+    i->last_heard = clock_time();
+    routingtable_changed(t, i);
     return 1;
 }
 
@@ -11,6 +11,9 @@
 #include "lib/list.h"
 #include "lib/memb.h"
 #include "net/rime.h"
+#include "bcp-config.h"
+
+struct routingtable_item;
 
 /**
  * \brief      A structure defines routing table
@@ -27,6 +30,28 @@ struct routingtable {
   struct memb *memb;
   //The parent BCP connection
   void* bcp_connection;
+  //Timer for the forwardable flags of the neighbors
+  struct ctimer forwardable_timer;
+  //Tells whether data can be sent to a neighbor, NULL if it always can
+  bool (* eligible)(struct routingtable_item *i);
+  //The best neighbors, largest weight first, with their last computed weight 
+  //and the queue length it was computed with (see bcp_routing_table_best.c)
+  struct routingtable_item *top[ROUTING_TABLE_TOP_K];
+  int top_weight[ROUTING_TABLE_TOP_K];
+  uint8_t top_count;
+  uint16_t top_queue_length;
+  //Set when the best neighbors must be searched among all the neighbors
+  bool top_invalid;
+#if BCP_ROUTING_TABLE_HASH
+  //Open addressing index of the neighbors by rime address: one more than the
+  //memb block of the record, zero for a free slot
+  uint8_t hash[ROUTING_TABLE_HASH_SIZE];
+  //The records packed at the start of the array, and the position of the 
+  //record of every memb block
+  struct routingtable_item *items[MAX_ROUTING_TABLE_SIZE];
+  uint8_t position[MAX_ROUTING_TABLE_SIZE];
+  uint8_t count;
+#endif
 };
 
 /**
@@ -53,6 +78,28 @@ struct routingtable_item {
   //backpressure does not relay on the hop count. However, any custom estimator 
   //can use this value if it is required.
   uint16_t hop_count;
+  
+  //Smoothed data-to-ACK round trip time of the neighbor, times 8. Zero until 
+  //the first ACK of the neighbor is received.
+  uint16_t srtt;
+  //Smoothed variation of the round trip time, times 4
+  uint16_t rttvar;
+  
+  //Last time a packet of the neighbor was heard. When the table is full, a 
+  //neighbor not heard for ROUTING_TABLE_STALE_TIME or one further from the 
+  //sink makes room for a new neighbor (see routing_table_update_hopCount).
+  clock_time_t last_heard;
+  
+  //Sequence number of the next new data packet sent to the neighbor
+  uint8_t tx_seq;
+  //Data packets received from the neighbor: the lowest sequence number not 
+  //received yet and, in bit k of rx_mask, whether rx_seq + k has been received
+  uint8_t rx_seq;
+  uint8_t rx_mask;
+  //Set once a data packet has been received from the neighbor
+  uint8_t rx_valid;
+  //Time at which the last new data packet of the neighbor was received
+  clock_time_t rx_heard;
 };
 
 
@@ -70,7 +117,8 @@ void routing_table_init(void *c);
  * \param addr the rime address of the neighbor 
  * \param queuelog the new queue log 
  * \param isData indicates whether the source of this queue log is coming from the data packet or not
- * \return Non-zero if the neighbor record was updated. Otherwise, zero
+ * \return Non-zero if the neighbor record was updated. Otherwise, zero: the 
+ *         table is full and no neighbor is stale.
  */
 int routing_table_update_queuelog(struct routingtable *t,
                                const rimeaddr_t * addr,
@@ -116,6 +164,10 @@ rimeaddr_t* routingtable_find_routing(struct routingtable *t);
 /**
  * \breif Updates the hop count for the given neighbor
  * 
+ *      A new neighbor which does not fit in the table replaces the stale 
+ *      neighbor heard the longest time ago, or else the neighbor with the 
+ *      largest hop count if it is further from the sink than the new one.
+ * 
  * \param t the routing table containing neighbor records
  * \param addr the rime address of the neighbor 
  * \param hop_count the new hop count
@@ -133,4 +185,103 @@ int routing_table_update_hopCount(struct routingtable *t,
  */
 struct routingtable_item* routing_table_find_shortestPath(struct routingtable *t);
 
+/**
+ * \breif Prints the records of the given routing table (only when DEBUG is enabled)
+ */
+void print_routingtable(struct routingtable *t);
+
+/**
+ * \breif Tells the routing table that the weight of a neighbor may have 
+ *        changed, e.g. the weight estimator learned about its link or the 
+ *        neighbor can no longer be used.
+ * \param t the routing table
+ * \param i the record of the neighbor
+ */
+void routingtable_changed(struct routingtable *t, struct routingtable_item *i);
+
+/**
+ * \breif Tells the routing table that the weights of all the neighbors may have
+ *        changed, e.g. the weight estimator changed the way it weighs them.
+ *        The next routingtable_find_routing() weighs every neighbor.
+ */
+void routingtable_invalidate(struct routingtable *t);
+
+/**
+ * \breif Sets the function telling whether data can be sent to a neighbor 
+ *        (NULL if it always can) and empties the best neighbors. Called by 
+ *        the routing tables when they are initialized.
+ */
+void routing_table_best_init(struct routingtable *t, bool (* eligible)(struct routingtable_item *i));
+
+/**
+ * \return true if the best neighbors must be searched among all the neighbors,
+ * see routing_table_best_reset()
+ */
+bool routing_table_best_invalid(struct routingtable *t);
+
+/**
+ * \breif Empties the best neighbors before all the neighbors are offered with
+ *        routing_table_best_offer()
+ */
+void routing_table_best_reset(struct routingtable *t);
+
+/**
+ * \breif Weighs the given neighbor and keeps it if it is one of the best. 
+ *        Among neighbors of the same weight, the last one offered wins.
+ */
+void routing_table_best_offer(struct routingtable *t, struct routingtable_item *i);
+
+/**
+ * \breif Forgets a neighbor which leaves the routing table. Called by the 
+ *        routing tables before the record is freed.
+ */
+void routing_table_best_removed(struct routingtable *t, struct routingtable_item *i);
+
+/**
+ * \return the neighbor of largest weight, or NULL if no neighbor has a 
+ * positive weight
+ */
+struct routingtable_item * routing_table_best(struct routingtable *t);
+
+/**
+ * \breif Adds a new neighbor to the routing table, in place of a less useful
+ *        one if the table is full (see routing_table_update_hopCount()).
+ * \return the new record, or NULL if the neighbor does not fit
+ */
+struct routingtable_item * routing_table_neighbor_add(struct routingtable *t,
+                               const rimeaddr_t * addr, uint16_t hop_count);
+
+/**
+ * \breif Removes the given neighbor from the routing table and frees it
+ */
+void routing_table_neighbor_remove(struct routingtable *t, struct routingtable_item *i);
+
+/**
+ * \breif Removes the neighbors which have not been heard for
+ *        ROUTING_TABLE_STALE_TIME
+ * \return the number of neighbors removed
+ */
+int routing_table_neighbor_purge(struct routingtable *t);
+
+/**
+ * \return the first neighbor of the routing table, or NULL if it is empty.
+ * Implemented by the routing tables for bcp_routing_table_neighbor.c
+ */
+struct routingtable_item * routing_table_neighbor_first(struct routingtable *t);
+
+/**
+ * \return the neighbor after the given one, or NULL if it is the last one
+ */
+struct routingtable_item * routing_table_neighbor_next(struct routingtable *t, struct routingtable_item *i);
+
+/**
+ * \breif Inserts a new record in the routing table
+ */
+void routing_table_neighbor_link(struct routingtable *t, struct routingtable_item *i);
+
+/**
+ * \breif Takes a record out of the routing table before it is freed
+ */
+void routing_table_neighbor_unlink(struct routingtable *t, struct routingtable_item *i);
+
 #endif /* __ROUTINGTABLE_H__ */
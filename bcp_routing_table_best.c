@@ -0,0 +1,169 @@
+/**
+ * \file
+ *         Best neighbors of the routing table (see \ref bcp_routing_table.h).
+ *         The ROUTING_TABLE_TOP_K neighbors of largest weight are kept next
+ *         to the routing table with the weights they had when last computed,
+ *         so choosing the next hop does not weigh every neighbor again:
+ *           - a neighbor whose record changed is weighed again alone and
+ *             moves in or out of the list,
+ *           - when the queue length changed, only the listed neighbors are
+ *             weighed again. The weights of the estimators move together
+ *             with the queue length, so their order hardly changes.
+ *         The list is rebuilt from all the neighbors only when it may miss a
+ *         better one (a listed neighbor left or fell below the list) and when
+ *         routingtable_invalidate() is called, which the routing tables do
+ *         once per forwardable period.
+ *
+ *         The routing table implementations call routing_table_best_*() and
+ *         build the list in routingtable_find_routing().
+ */
+#include "bcp_routing_table.h"
+#include "bcp.h"
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/**
+ * \return true if data can be sent to the given neighbor
+ */
+static bool eligible(struct routingtable *t, struct routingtable_item *i){
+    return t->eligible == NULL || t->eligible(i);
+}
+
+/**
+ * \return the position of the given neighbor in the list, or -1
+ */
+static int position_of(struct routingtable *t, struct routingtable_item *i){
+    int k;
+
+    for(k = 0; k < t->top_count; k++){
+        if(t->top[k] == i)
+            return k;
+    }
+    return -1;
+}
+
+/**
+ * \breif Removes the neighbor at the given position of the list
+ */
+static void take(struct routingtable *t, int k){
+    t->top_count--;
+    for(; k < t->top_count; k++){
+        t->top[k] = t->top[k + 1];
+        t->top_weight[k] = t->top_weight[k + 1];
+    }
+}
+
+/**
+ * \breif Inserts a neighbor which is not in the list. It goes before the
+ *        neighbors of the same weight, so the last one offered wins a tie as
+ *        in a full search.
+ */
+static void put(struct routingtable *t, struct routingtable_item *i, int w){
+    int k, j;
+
+    for(k = 0; k < t->top_count && t->top_weight[k] > w; k++);
+    if(k >= ROUTING_TABLE_TOP_K)
+        return;
+
+    if(t->top_count < ROUTING_TABLE_TOP_K)
+        t->top_count++;
+    for(j = t->top_count - 1; j > k; j--){
+        t->top[j] = t->top[j - 1];
+        t->top_weight[j] = t->top_weight[j - 1];
+    }
+    t->top[k] = i;
+    t->top_weight[k] = w;
+}
+
+void routing_table_best_init(struct routingtable *t, bool (* eligible)(struct routingtable_item *i)){
+    t->eligible = eligible;
+    t->top_count = 0;
+    t->top_invalid = true;
+}
+
+void routingtable_invalidate(struct routingtable *t){
+    t->top_invalid = true;
+}
+
+bool routing_table_best_invalid(struct routingtable *t){
+    return t->top_invalid;
+}
+
+void routing_table_best_reset(struct routingtable *t){
+    t->top_count = 0;
+    t->top_invalid = false;
+    t->top_queue_length = bcp_queue_length(&((struct bcp_conn *) t->bcp_connection)->packet_queue);
+}
+
+void routing_table_best_offer(struct routingtable *t, struct routingtable_item *i){
+    if(eligible(t, i))
+        put(t, i, weight_estimator_getWeight(t->bcp_connection, i));
+}
+
+void routing_table_best_removed(struct routingtable *t, struct routingtable_item *i){
+    int k = position_of(t, i);
+
+    if(k < 0)
+        return;
+    //A neighbor below the list may take the free place
+    if(t->top_count == ROUTING_TABLE_TOP_K)
+        t->top_invalid = true;
+    take(t, k);
+}
+
+void routingtable_changed(struct routingtable *t, struct routingtable_item *i){
+    int k, w;
+    bool full;
+
+    if(t->top_invalid)
+        return;
+    if(!eligible(t, i)){
+        routing_table_best_removed(t, i);
+        return;
+    }
+
+    w = weight_estimator_getWeight(t->bcp_connection, i);
+    k = position_of(t, i);
+    full = t->top_count == ROUTING_TABLE_TOP_K;
+
+    if(k >= 0){
+        //A neighbor below the list may now be better than this one
+        if(full && w < t->top_weight[ROUTING_TABLE_TOP_K - 1]){
+            PRINTF("DEBUG: Neighbor[%d].[%d] fell below the best neighbors\n",
+                    i->neighbor.u8[0], i->neighbor.u8[1]);
+            t->top_invalid = true;
+            return;
+        }
+        take(t, k);
+        put(t, i, w);
+    }else if(!full || w > t->top_weight[ROUTING_TABLE_TOP_K - 1]){
+        put(t, i, w);
+    }
+}
+
+struct routingtable_item * routing_table_best(struct routingtable *t){
+    struct routingtable_item *listed[ROUTING_TABLE_TOP_K];
+    uint16_t len = bcp_queue_length(&((struct bcp_conn *) t->bcp_connection)->packet_queue);
+    int k, n;
+
+    //Weigh the listed neighbors again with the new queue length
+    if(len != t->top_queue_length){
+        t->top_queue_length = len;
+        n = t->top_count;
+        memcpy(listed, t->top, sizeof(listed));
+        t->top_count = 0;
+        for(k = 0; k < n; k++)
+            put(t, listed[k], weight_estimator_getWeight(t->bcp_connection, listed[k]));
+    }
+
+    if(t->top_count == 0 || t->top_weight[0] < 1)
+        return NULL;
+    return t->top[0];
+}
@@ -7,6 +7,7 @@
 #include "bcp_routing_table.h"
 #include "bcp.h"
 #include "fusion_config.h"
+#include <stddef.h>  //For offsetof
 
 #define DEBUG 0
 #if DEBUG
@@ -22,46 +23,218 @@ struct parent_estiblished_msg {
  
 };
 
-//Timer for forwardable flag
+/**
+ * \brief      The parents of the node in the DAG of a BCP connection
+ * 
+ *             The parents are the neighbors closer to the sink than the node, 
+ *             so following them never leads back to the node. Data is sent to
+ *             the parent of largest weight (backlog differential), which 
+ *             spreads the traffic among them. When a parent goes away, stops 
+ *             being closer to the sink or becomes a child, the parents are 
+ *             chosen again before the next packet is sent.
+ */
+struct dag_parents {
+  //Used to tell the parents that we are their child, on the channel after the hop counter
+  struct runicast_conn unicast_conn;
+  //Tells the parents one after the other
+  struct ctimer tell_timer;
+  //The BCP connection
+  struct bcp_conn * bcp;
+  //The parents, closest to the sink first, then the least loaded first
+  struct routingtable_item * parents[NUM_PARENTS];
+  //Whether each parent knows that we are its child
+  bool told[NUM_PARENTS];
+  //The hop count of the node when the parents were chosen
+  uint16_t hop_count;
+  //Set when the parents must be chosen again before sending
+  bool stale;
+};
+
+//Period of the forwardable timer
 clock_time_t time_fe = CLOCK_SECOND * 10;
-struct ctimer forwardable_timer; 
-static struct routingtable_item * parents[NUM_PARENTS];
-struct runicast_conn unicast_conn;
-static uint16_t uni_channel = 32; //Temp channel
-static struct bcp_conn * active_bcp;
-static int parent_counter;
+//The parents of every opened connection, see bcp_conn.index
+static struct dag_parents dags[BCP_MAX_CONNECTIONS];
+
+void prepareMessage();
 
+struct routingtable_item * routing_table_neighbor_first(struct routingtable *t){
+    return list_head(*t->list);
+}
+
+struct routingtable_item * routing_table_neighbor_next(struct routingtable *t, struct routingtable_item *i){
+    return list_item_next(i);
+}
+
+void routing_table_neighbor_link(struct routingtable *t, struct routingtable_item *i){
+    list_add(*t->list, i);
+}
+
+void routing_table_neighbor_unlink(struct routingtable *t, struct routingtable_item *i){
+    struct dag_parents * d = &dags[((struct bcp_conn *) t->bcp_connection)->index];
+    int k;
+    
+    //It is no longer a parent, another one takes its place before sending
+    for(k = 0; k < NUM_PARENTS; k++){
+        if(d->parents[k] == i){
+            d->parents[k] = NULL;
+            d->stale = true;
+        }
+    }
+
+    list_remove(*t->list, i);
+}
+
+/**
+ * \return true if the neighbor is one of the parents, data is only sent to them
+ */
+static bool neighbor_parent(struct routingtable_item *i){
+    return i->forwardable == 1;
+}
+
+/**
+ * \return true if the neighbor may be a parent: it is closer to the sink
+ * than the node, whose hop count is given (zero if unknown)
+ */
+static bool neighbor_closer(struct routingtable_item *i, uint16_t hop_count){
+    return i->hop_count != 0 && (hop_count == 0 || i->hop_count < hop_count);
+}
+
+/**
+ * \return true if parent a ranks before parent b: it is closer to the sink,
+ * or else its queue is shorter
+ */
+static bool parent_before(struct routingtable_item *a, struct routingtable_item *b){
+    if(a->hop_count != b->hop_count)
+        return a->hop_count < b->hop_count;
+    return a->backpressure < b->backpressure;
+}
+
+static struct dag_parents * dag_of(struct runicast_conn *c){
+    return (struct dag_parents *)((char *)c - offsetof(struct dag_parents, unicast_conn));
+}
+
+/**
+ * \breif Tells the next parent which does not know it yet that we are its 
+ *        child. Only one message is sent at a time, the next one when it 
+ *        has been acknowledged or has timed out.
+ */
+static void tell_parents(void *v){
+    struct dag_parents * d = (struct dag_parents *) v;
+    int k;
+    
+    if(runicast_is_transmitting(&d->unicast_conn))
+        return;
+    
+    for(k = 0; k < NUM_PARENTS; k++){
+        if(d->parents[k] != NULL && !d->told[k]){
+            d->told[k] = true;
+            prepareMessage();
+            runicast_send(&d->unicast_conn, &d->parents[k]->neighbor, 10);
+            return;
+        }
+    }
+}
+
+/**
+ * \breif Chooses the parents among the neighbors closer to the sink, the 
+ *        NUM_PARENTS closest first and then the least loaded. The other 
+ *        neighbors, children excepted, are not forwardable.
+ */
+static void choose_parents(struct bcp_conn *bcp_c){
+    struct routingtable *t = &bcp_c->routing_table;
+    struct dag_parents * d = &dags[bcp_c->index];
+    struct routingtable_item * parents[NUM_PARENTS];
+    bool told[NUM_PARENTS];
+    uint16_t hop_count = bcp_c->hop_counter.hop_count;
+    struct routingtable_item *i;
+    int k, j;
+    
+    for(k = 0; k < NUM_PARENTS; k++){
+        parents[k] = NULL;
+        told[k] = false;
+    }
+    
+    //For each neighbor  
+    for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
+        
+        //If the neighbor is a child
+        if(i->forwardable == 250){
+            //Since bidirectional links are not allowed in DAG, unless it is 
+            //now closer to the sink and no longer our child
+            if(!neighbor_closer(i, hop_count))
+                continue;
+        }
+        
+        i->forwardable = 10; //Disable forwarding initially     
+        if(!neighbor_closer(i, hop_count))
+            continue;
+        //For each parent
+        for(k = 0; k < NUM_PARENTS; k++){
+           if(parents[k] == NULL || parent_before(i, parents[k])){
+               //Shift the reset of parents one down
+               for(j = NUM_PARENTS-2; j >= k; j--){
+                    parents[j+1] = parents[j];
+               }
+               //Add the new parent
+               parents[k] = i;
+               break;
+           }
+        }
+    }
+    
+    //The parents which are kept already know that we are their child
+    for(k = 0; k < NUM_PARENTS; k++){
+        for(j = 0; j < NUM_PARENTS && parents[k] != NULL; j++){
+            if(d->parents[j] == parents[k])
+                told[k] = d->told[j];
+        }
+        d->parents[k] = parents[k];
+        d->told[k] = told[k];
+        if(parents[k] != NULL)
+            parents[k]->forwardable = 1;
+    }
+    d->hop_count = hop_count;
+    d->stale = false;
+    
+    //The parents changed, weigh them again
+    routingtable_invalidate(t);
+    //Tell the new parents, out of the caller's packetbuf
+    ctimer_set(&d->tell_timer, 0, tell_parents, d);
+}
 
 static void recv_from_unicast(struct runicast_conn *c, const rimeaddr_t *from, uint8_t sq)
 {
+    struct dag_parents * d = dag_of(c);
     struct routingtable_item *i;
+    int k;
    
-    i = routing_table_find(&active_bcp->routing_table,from);
+    i = routing_table_find(&d->bcp->routing_table,from);
     PRINTF("DEBUG: Receiving Parent estiblishment message from node[%d].[%d]\n",
             from->u8[0], from->u8[1]);
     if(i != NULL){
+        //A parent which becomes a child is replaced before sending
+        for(k = 0; k < NUM_PARENTS; k++){
+            if(d->parents[k] == i)
+                d->stale = true;
+        }
         i->forwardable = 250; //Meaning this neighbor is a child and data should not be forwarded to him
+        routingtable_changed(&d->bcp->routing_table, i);
     }
     
-    //print_routingtable(&active_bcp->routing_table);
+    //print_routingtable(&dag_of(c)->bcp->routing_table);
 }
 
 static void sent_from_unicast(struct runicast_conn *c, const rimeaddr_t *from, uint8_t atmp){
-    struct routingtable_item * nested = NULL; 
-    parent_counter++;
     PRINTF("DEBUG: Parent estiblishment message sent to node[%d].[%d]\n", from->u8[0], from->u8[1]);
-     if(parent_counter < NUM_PARENTS){
-        nested = parents[parent_counter];
-        if(nested != NULL){
-           nested->forwardable = 1;
-           
-           prepareMessage();
-           runicast_send(&unicast_conn,&nested->neighbor,10);
-        }
-     }
+    tell_parents(dag_of(c));
+}
+
+static void timedout_from_unicast(struct runicast_conn *c, const rimeaddr_t *from, uint8_t atmp){
+    PRINTF("DEBUG: Parent estiblishment message to node[%d].[%d] timed out\n", from->u8[0], from->u8[1]);
+    tell_parents(dag_of(c));
 }
 
-static const struct runicast_callbacks uni_callbacks = { recv_from_unicast, sent_from_unicast };
+static const struct runicast_callbacks uni_callbacks = { recv_from_unicast, sent_from_unicast, timedout_from_unicast };
 
 void prepareMessage(){
      packetbuf_clear();
@@ -78,60 +251,14 @@ void prepareMessage(){
 void updateForwardable(void* v){
     //Get the neighbors with forwardable flag != 1
     struct bcp_conn * bcp_c = (struct bcp_conn *) v;
-    
     struct routingtable *t = &bcp_c->routing_table;
-    int k, j;
-    struct routingtable_item *i = NULL;
-    struct routingtable_item * nested = NULL;
    
     //PRINTF("Update forwardable flags has been started\n");
-    //Reset the parents
-    for(k = 0; k < NUM_PARENTS; k++){
-        parents[k] = NULL;
-    }
-    
-   
-    
-    //For each neighbor  
-    for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
-        
-        //If the neighbor is a child
-        if(i->forwardable == 250){
-            continue; //Since bidirectional links are not allowed in DAG
-        }
-        
-        i->forwardable = 10; //Disable forwarding initially     
-        if(i->hop_count != 0)
-        //For each parent
-        for(k = 0; k < NUM_PARENTS; k++){
-           nested = parents[k];
-           if(nested == NULL){
-               parents[k] = i;
-              
-               break;
-           }else{
-               if( i->hop_count < nested->hop_count){
-                   //Shift the reset of parents one down
-                   for(j = NUM_PARENTS-2; j >= k; j--){
-                        parents[j+1] = parents[j];
-                   }
-                   //Add the new parent
-                  
-                   parents[k] = i;
-                   break;
-               }
-           }
-        }
-    }
+    //Forget the neighbors which are gone
+    if(routing_table_neighbor_purge(t) > 0)
+        hop_counter_update(bcp_c);
     
-    //Update the forwardable flag based on the new parent table
-    parent_counter = 0;
-    nested = parents[parent_counter];
-    if(nested != NULL){
-       nested->forwardable = 1;
-       prepareMessage();
-       runicast_send(&unicast_conn,&nested->neighbor,10);
-    }
+    choose_parents(bcp_c);
   
     print_routingtable(t);
  }
@@ -143,17 +270,24 @@ void routing_table_init(void *c){
     bcp_c->routing_table.bcp_connection = c;
     //Init the list
     list_init(bcp_c->routing_table_list);
+    routing_table_best_init(&bcp_c->routing_table, neighbor_parent);
    
     PRINTF("DEBUG: Bcp routing table has been initialized \n");
-    active_bcp = bcp_c;
-    runicast_open(&unicast_conn, uni_channel, &uni_callbacks);
+    //Nothing is left of a connection which used the same slot before
+    ctimer_stop(&dags[bcp_c->index].tell_timer);
+    memset(dags[bcp_c->index].parents, 0, sizeof(dags[bcp_c->index].parents));
+    memset(dags[bcp_c->index].told, 0, sizeof(dags[bcp_c->index].told));
+    dags[bcp_c->index].hop_count = 0;
+    dags[bcp_c->index].stale = true;
+    dags[bcp_c->index].bcp = bcp_c;
+    runicast_open(&dags[bcp_c->index].unicast_conn, bcp_c->channel + 3, &uni_callbacks);
 }
 
 struct routingtable_item* routing_table_find(struct routingtable *t,
                                const rimeaddr_t * addr){
      struct routingtable_item *i = NULL;
    
-    // Check for entry using binary search as number of records is usually very limited
+    // Check for entry using linear search as number of records is usually very limited (see bcp_routing_table_hash.c otherwise)
     for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
       if(rimeaddr_cmp(&(i->neighbor), addr))
         break;
@@ -169,30 +303,17 @@ int routing_table_update_queuelog(struct routingtable *t,
    
     i = routing_table_find(t, addr);
     
-    //No record for this neighbor address
+    //No record for this neighbor address, its hop count is not known yet
     if(i == NULL) {
-        // Allocate memory for the new record
-        i = memb_alloc(t->memb);
+        i = routing_table_neighbor_add(t, addr, 0);
 
         //Failed to allocate memory
         if(i == NULL) {
           return 0;
         }
-
-        // Set default attributes
-        i->next = NULL;
-        rimeaddr_copy(&(i->neighbor), addr);
-        i->backpressure = queuelog;
-        
-        
-        //Ask weight estimator to initialize its fields 
-        weight_estimator_record_init(i);
-        
-        //Insert the new record
-        list_add(*t->list, i);
-    }else{
-        i->backpressure = queuelog;
     }
+    i->backpressure = queuelog;
+    i->last_heard = clock_time();
     
     if ((int) queuelog < 0 || queuelog > MAX_PACKET_QUEUE_SIZE ){
         i->backpressure =  MAX_PACKET_QUEUE_SIZE;
@@ -209,6 +330,7 @@ int routing_table_update_queuelog(struct routingtable *t,
     PRINTF("DEBUG: Changing queuelog for node[%d].[%d]. Mark the node as unforwardable for the next %d time slot(s) \n"
             , addr->u8[0], addr->u8[1],  i->forwardable -1);
     }
+    routingtable_changed(t, i);
 
     //dbg_print_rtable(t);
     return 1;
@@ -224,9 +346,8 @@ int routingtable_length(struct routingtable *t)
 void routingtable_clear(struct routingtable *t){
     
    struct routingtable_item *i;
-   for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
-       list_remove(*t->list, i);
-       memb_free(t->memb, i);
+   while((i = list_head(*t->list)) != NULL) {
+       routing_table_neighbor_remove(t, i);
    }
    
    PRINTF("DEBUG: Routing table has been cleared\n");
@@ -234,11 +355,12 @@ void routingtable_clear(struct routingtable *t){
 
 
 void routingtable_clearForwardable(struct routingtable *t){
-   struct routingtable_item *i;
-   for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
+   struct routingtable_item *i, *next;
+   for(i = list_head(*t->list); i != NULL; i = next) {
+       //list_remove() clears the next pointer of the removed item
+       next = list_item_next(i);
        if(i->forwardable == 1){
-            list_remove(*t->list, i);
-            memb_free(t->memb, i);
+            routing_table_neighbor_remove(t, i);
        }
    } 
 }
@@ -246,23 +368,23 @@ void routingtable_clearForwardable(struct routingtable *t){
 
 rimeaddr_t* routingtable_find_routing( struct routingtable *t){
    
-   int largestWeight = -32768;
-   int neighborWeight;
-   struct routingtable_item * largestNeightbor = NULL;
+   struct bcp_conn * c = (struct bcp_conn *) t->bcp_connection;
+   struct routingtable_item * largestNeightbor;
    struct routingtable_item *i;
-   //For each neighbor stored 
-   for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
-       //If smallest weight variable is not yet set 
-       neighborWeight = weight_estimator_getWeight(t->bcp_connection, i);
-       //Has this neighbor smaller weight
-       //Temp Test
-       if(largestWeight <= neighborWeight && i->forwardable == 1){
-           largestWeight = neighborWeight;
-           largestNeightbor = i;
+   //Fail over to the other neighbors closer to the sink without waiting for
+   //the forwardable timer
+   if(dags[c->index].stale || dags[c->index].hop_count != c->hop_counter.hop_count)
+       choose_parents(c);
+   //Weigh the parents only when the best ones may be unknown
+   if(routing_table_best_invalid(t)){
+       routing_table_best_reset(t);
+       for(i = list_head(*t->list); i != NULL; i = list_item_next(i)) {
+           routing_table_best_offer(t, i);
        }
    }
+   largestNeightbor = routing_table_best(t);
    //No result
-   if(largestNeightbor == NULL || largestWeight < 1)
+   if(largestNeightbor == NULL)
        return NULL;
   
    
@@ -277,33 +399,30 @@ rimeaddr_t* routingtable_find_routing( struct routingtable *t){
 int routing_table_update_hopCount(struct routingtable *t,
                                const rimeaddr_t * addr,
                                uint16_t hop_count){
+    struct bcp_conn * c = (struct bcp_conn *) t->bcp_connection;
     struct routingtable_item *i;
    
     i = routing_table_find(t, addr);
     
     //No record for this neighbor address
     if(i == NULL) {
-        // Allocate memory for the new record
-        i = memb_alloc(t->memb);
+        i = routing_table_neighbor_add(t, addr, hop_count);
 
         //Failed to allocate memory
         if(i == NULL) {
           return 0;
         }
-
-        // Set default attributes
-        i->next = NULL;
-        rimeaddr_copy(&(i->neighbor), addr);
-        i->backpressure = 0;
-        i->hop_count = hop_count;
-        //Ask weight estimator to initialize its fields 
-        weight_estimator_record_init(i);
-        
-        //Insert the new record
-        list_add(*t->list, i);
-    }else{
-        i->hop_count = hop_count;
     }
+    i->hop_count = hop_count;
+    i->last_heard = clock_time();
+    routingtable_changed(t, i);
+    
+    //Choose the parents again before sending if a parent is no longer closer 
+    //to the sink, or if a closer neighbor may take a free place
+    if(i->forwardable == 1 ? !neighbor_closer(i, c->hop_counter.hop_count) :
+       i->forwardable != 250 && neighbor_closer(i, c->hop_counter.hop_count) &&
+       dags[c->index].parents[NUM_PARENTS - 1] == NULL)
+        dags[c->index].stale = true;
     return 1;
 }
 
@@ -326,8 +445,11 @@ struct routingtable_item* routing_table_find_shortestPath(struct routingtable *t
     
     //Since this function has been called, it means the hop counter for 
     //this node has been calculated. 
-    //Start the forwardable timer to choose the parent nodes
-    ctimer_set(&forwardable_timer, time_fe, updateForwardable, t->bcp_connection);
+    //Start the forwardable timer to choose the parent nodes. The hop counter
+    //calls this function for every packet heard, so a running timer is kept
+    //and the parents are chosen again every time_fe.
+    if(ctimer_expired(&t->forwardable_timer))
+        ctimer_set(&t->forwardable_timer, time_fe, updateForwardable, t->bcp_connection);
 
     
     return result;
@@ -0,0 +1,355 @@
+/**
+ * \file
+ *         Hashed implementation of the routing table (see \ref bcp_routing_table.h).
+ *         The neighbors are found through an open addressing index on their
+ *         rime address (linear probing, ROUTING_TABLE_HASH_SIZE slots of one
+ *         byte), so the lookup done for every beacon, overheard data packet,
+ *         ACK and send reads one or two slots instead of walking the list.
+ *         The records are packed at the start of an array, which is what
+ *         the searches for the best and the closest neighbor walk.
+ *         The behavior is the one of bcp_routing_table.c.
+ *
+ *         Requires BCP_ROUTING_TABLE_HASH to be set to 1 (see bcp-config.h).
+ */
+
+#include "bcp_routing_table.h"
+#include "bcp.h"
+#include <stdbool.h>
+#include <string.h>
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "net/rime.h"
+
+#if !BCP_ROUTING_TABLE_HASH
+#error "bcp_routing_table_hash.c requires BCP_ROUTING_TABLE_HASH=1"
+#endif
+
+#if (ROUTING_TABLE_HASH_SIZE & (ROUTING_TABLE_HASH_SIZE - 1)) != 0 \
+    || ROUTING_TABLE_HASH_SIZE <= MAX_ROUTING_TABLE_SIZE
+#error "ROUTING_TABLE_HASH_SIZE must be a power of two larger than MAX_ROUTING_TABLE_SIZE"
+#endif
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define HASH_MASK (ROUTING_TABLE_HASH_SIZE - 1)
+#define HASH_FREE 0
+
+//Period of the forwardable timer
+clock_time_t time_fe = CLOCK_SECOND * SLOT_DURATION;
+
+/**
+ * \return the home slot of the given address in the index
+ */
+static uint8_t hash_of(const rimeaddr_t *addr){
+    return (addr->u8[0] ^ (addr->u8[1] * 37)) & HASH_MASK;
+}
+
+/**
+ * \return the memb block of the given record
+ */
+static uint8_t block_of(struct routingtable *t, struct routingtable_item *i){
+    return ((char *)i - (char *)t->memb->mem) / t->memb->size;
+}
+
+static struct routingtable_item * item_of(struct routingtable *t, uint8_t b){
+    return (struct routingtable_item *)((char *)t->memb->mem + b * t->memb->size);
+}
+
+/**
+ * \return the index slot of the given address, or -1 if it is not in the table
+ */
+static int hash_find(struct routingtable *t, const rimeaddr_t *addr){
+    uint8_t h = hash_of(addr);
+
+    //The index is never full, so the probe ends on a free slot
+    while(t->hash[h] != HASH_FREE){
+        if(rimeaddr_cmp(&item_of(t, t->hash[h] - 1)->neighbor, addr))
+            return h;
+        h = (h + 1) & HASH_MASK;
+    }
+    return -1;
+}
+
+/**
+ * \breif Adds the given record to the index and to the packed records
+ */
+void routing_table_neighbor_link(struct routingtable *t, struct routingtable_item *i){
+    uint8_t h = hash_of(&i->neighbor);
+    uint8_t b = block_of(t, i);
+
+    while(t->hash[h] != HASH_FREE)
+        h = (h + 1) & HASH_MASK;
+    t->hash[h] = b + 1;
+
+    t->items[t->count] = i;
+    t->position[b] = t->count;
+    t->count++;
+}
+
+/**
+ * \breif Removes the given record from the index and from the packed records
+ */
+void routing_table_neighbor_unlink(struct routingtable *t, struct routingtable_item *i){
+    int found = hash_find(t, &i->neighbor);
+    uint8_t b = block_of(t, i);
+    uint8_t free_slot, h, home;
+    struct routingtable_item *last;
+
+    if(found < 0)
+        return;
+
+    //Move back the records probed past the freed slot, so that no probe
+    //stops early (deletion of linear probing, no tombstones)
+    free_slot = found;
+    t->hash[free_slot] = HASH_FREE;
+    for(h = (free_slot + 1) & HASH_MASK; t->hash[h] != HASH_FREE; h = (h + 1) & HASH_MASK){
+        home = hash_of(&item_of(t, t->hash[h] - 1)->neighbor);
+        if(((h - home) & HASH_MASK) >= ((h - free_slot) & HASH_MASK)){
+            t->hash[free_slot] = t->hash[h];
+            t->hash[h] = HASH_FREE;
+            free_slot = h;
+        }
+    }
+
+    //The last record takes the place of the removed one
+    t->count--;
+    last = t->items[t->count];
+    t->items[t->position[b]] = last;
+    t->position[block_of(t, last)] = t->position[b];
+}
+
+struct routingtable_item * routing_table_neighbor_first(struct routingtable *t){
+    return t->count > 0 ? t->items[0] : NULL;
+}
+
+struct routingtable_item * routing_table_neighbor_next(struct routingtable *t, struct routingtable_item *i){
+    uint8_t k = t->position[block_of(t, i)] + 1;
+
+    return k < t->count ? t->items[k] : NULL;
+}
+
+/**
+ * \breif updates the forwardable flag for all neighbors.
+ *
+ *      This function is called by the forwardable timer at the beginning of every
+ *      time slot (t).
+ *
+ */
+void updateForwardable(void* v){
+    //Get the neighbors with forwardable flag != 1
+    struct bcp_conn * bcp_c = (struct bcp_conn *) v;
+    struct routingtable *t = &bcp_c->routing_table;
+    struct routingtable_item *i;
+    uint8_t k;
+
+    //Forget the neighbors which are gone
+    if(routing_table_neighbor_purge(t) > 0)
+        hop_counter_update(bcp_c);
+
+    //For each neighbor
+    for(k = 0; k < t->count; k++) {
+        i = t->items[k];
+        if(i->forwardable != 1){
+
+            if(i->forwardable < 1)
+                i->forwardable = 2;
+
+            i->forwardable -= 1;
+            PRINTF("DEBUG: Updata forwardable flag for neighbor[%d].[%d] to %d \n",
+                    i->neighbor.u8[0], i->neighbor.u8[1], i->forwardable);
+
+        }
+    }
+    //Weigh every neighbor again once per time slot
+    routingtable_invalidate(t);
+    //Reset the timer
+    ctimer_set(&t->forwardable_timer, time_fe, updateForwardable, bcp_c);
+ }
+
+void routing_table_init(void *c){
+    //Setup bcp
+    struct bcp_conn * bcp_c = (struct bcp_conn *) c;
+    bcp_c->routing_table.list = &(bcp_c->routing_table_list);
+    bcp_c->routing_table.bcp_connection = c;
+
+    //The list is not used by this routing table but kept initialized for the other components
+    list_init(bcp_c->routing_table_list);
+    memset(bcp_c->routing_table.hash, HASH_FREE, sizeof(bcp_c->routing_table.hash));
+    bcp_c->routing_table.count = 0;
+
+    routing_table_best_init(&bcp_c->routing_table, NULL);
+
+    //Start the forwardable timer
+    ctimer_set(&bcp_c->routing_table.forwardable_timer, time_fe, updateForwardable, bcp_c);
+
+    PRINTF("DEBUG: Bcp routing table has been initialized. length=%d \n", routingtable_length(&bcp_c->routing_table));
+}
+
+struct routingtable_item* routing_table_find(struct routingtable *t,
+                               const rimeaddr_t * addr){
+    int h = hash_find(t, addr);
+
+    return h < 0 ? NULL : item_of(t, t->hash[h] - 1);
+}
+
+int routing_table_update_queuelog(struct routingtable *t,
+                               const rimeaddr_t * addr,
+                               uint16_t queuelog, uint16_t isData){
+    struct routingtable_item *i;
+
+    i = routing_table_find(t, addr);
+
+    //No record for this neighbor address, its hop count is not known yet
+    if(i == NULL) {
+        i = routing_table_neighbor_add(t, addr, 0);
+
+        //Failed to allocate memory
+        if(i == NULL) {
+          return 0;
+        }
+    }
+    i->backpressure = queuelog;
+    i->last_heard = clock_time();
+
+    if ((int) queuelog < 0 || queuelog > MAX_PACKET_QUEUE_SIZE ){
+        i->backpressure =  MAX_PACKET_QUEUE_SIZE;
+    }
+
+    if(isData == 1){
+    //To avoid loop, we will set the forwardable flag so that this node
+    //will not forward any data to this neighbor for the next ten time
+    // slots
+    i->forwardable = 11; //This value is decreased by 1 at the beginning of
+                         //every time slot
+    PRINTF("DEBUG: Changing queuelog for node[%d].[%d]. Mark the node as unforwardable for the next %d time slot(s) \n"
+            , addr->u8[0], addr->u8[1],  i->forwardable -1);
+    }
+    routingtable_changed(t, i);
+
+    print_routingtable(t);
+    return 1;
+}
+
+int routingtable_length(struct routingtable *t)
+{
+  return t->count;
+}
+
+
+
+void routingtable_clear(struct routingtable *t){
+
+   while(t->count > 0) {
+       routing_table_neighbor_remove(t, t->items[t->count - 1]);
+   }
+
+   PRINTF("DEBUG: Routing table has been cleared\n");
+}
+
+
+void routingtable_clearForwardable(struct routingtable *t){
+   uint8_t k = 0;
+
+   //A removed record is replaced by the last one, which is checked next
+   while(k < t->count) {
+       if(t->items[k]->forwardable == 1){
+            routing_table_neighbor_remove(t, t->items[k]);
+       }else{
+            k++;
+       }
+   }
+}
+
+
+rimeaddr_t* routingtable_find_routing( struct routingtable *t){
+
+   struct routingtable_item * largestNeightbor;
+   uint8_t k;
+   //Weigh every neighbor stored only when the best ones may be unknown
+   if(routing_table_best_invalid(t)){
+       routing_table_best_reset(t);
+       for(k = 0; k < t->count; k++) {
+           routing_table_best_offer(t, t->items[k]);
+       }
+   }
+   largestNeightbor = routing_table_best(t);
+   //No result
+   if(largestNeightbor == NULL)
+       return NULL;
+
+
+     PRINTF("DEBUG: Best neighbor to send the data packet is node[%d].[%d] \n",
+               largestNeightbor->neighbor.u8[0],
+               largestNeightbor->neighbor.u8[1]);
+    print_routingtable(t);
+   //The rime address of the neighbor
+   return (&largestNeightbor->neighbor);
+}
+
+int routing_table_update_hopCount(struct routingtable *t,
+                               const rimeaddr_t * addr,
+                               uint16_t hop_count){
+    struct routingtable_item *i;
+
+    i = routing_table_find(t, addr);
+
+    //No record for this neighbor address
+    if(i == NULL) {
+        i = routing_table_neighbor_add(t, addr, hop_count);
+
+        //Failed to allocate memory
+        if(i == NULL) {
+          return 0;
+        }
+    }
+    i->hop_count = hop_count;
+    i->last_heard = clock_time();
+    routingtable_changed(t, i);
+    return 1;
+}
+
+struct routingtable_item* routing_table_find_shortestPath(struct routingtable *t){
+
+    struct routingtable_item* result = NULL;
+    uint16_t smallestHop_count = 0xffff;
+    uint8_t k;
+
+    //For each neighbor
+    for(k = 0; k < t->count; k++) {
+        //Zero neighbor hop-count means that the neighbor's hop_count has not
+        //been calculated yet
+        if (t->items[k]->hop_count <= smallestHop_count && t->items[k]->hop_count != 0){
+            result = t->items[k];
+            smallestHop_count = result->hop_count;
+        }
+    }
+    return result;
+}
+/*---------------------------------------------------------------------------*/
+ void print_routingtable(struct routingtable *t)
+{
+  #if DEBUG
+  struct routingtable_item *i;
+  uint8_t k;
+
+  PRINTF("Routing Table Contents: %d entries found\n", t->count);
+  PRINTF("------------------------------------------------------------\n");
+  for(k = 0; k < t->count; k++) {
+    i = t->items[k];
+    PRINTF("Routing table item: %d (index slot %d)\n", k, hash_find(t, &i->neighbor));
+    PRINTF("neighbor: %d.%d\n", i->neighbor.u8[0], i->neighbor.u8[1]);
+    PRINTF("backpressure: %d\n", i->backpressure);
+    PRINTF("forwardable: %d\n",  i->forwardable);
+    PRINTF("hop-count: %d\n",  i->hop_count);
+    weight_estimator_print_item(t->bcp_connection, i);
+    PRINTF("------------------------------------------------------------\n");
+  }
+  #endif
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,139 @@
+/**
+ * \file
+ *         Neighbor records of the routing table (see \ref bcp_routing_table.h).
+ *         Adding, replacing, purging and removing a neighbor is the same for
+ *         every routing table implementation; only the way the records are
+ *         walked and stored differs. The routing table implementations
+ *         provide routing_table_neighbor_first(), routing_table_neighbor_next(),
+ *         routing_table_neighbor_link() and routing_table_neighbor_unlink()
+ *         and call routing_table_neighbor_*() to change their records.
+ */
+#include "bcp_routing_table.h"
+#include "bcp.h"
+#include "lib/random.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/**
+ * \return true if the neighbor has not been heard for ROUTING_TABLE_STALE_TIME
+ */
+static bool neighbor_stale(struct routingtable_item *i, clock_time_t now){
+    return (clock_time_t)(now - i->last_heard) >= ROUTING_TABLE_STALE_TIME;
+}
+
+/**
+ * \return the hop count of the neighbor, an unknown one being the largest
+ */
+static uint16_t neighbor_hops(struct routingtable_item *i){
+    return i->hop_count != 0 ? i->hop_count : 0xffff;
+}
+
+/**
+ * \return true if a is less useful than b: a is stale and b is not, or else
+ * a is further from the sink, or else a has been heard longer ago.
+ */
+static bool neighbor_worse(struct routingtable_item *a, struct routingtable_item *b,
+                           clock_time_t now){
+    bool staleA = neighbor_stale(a, now);
+
+    if(staleA != neighbor_stale(b, now))
+        return staleA;
+    if(!staleA && neighbor_hops(a) != neighbor_hops(b))
+        return neighbor_hops(a) > neighbor_hops(b);
+    return (clock_time_t)(now - a->last_heard) > (clock_time_t)(now - b->last_heard);
+}
+
+/**
+ * \return the neighbor to replace by a new neighbor of the given hop count
+ * (zero if unknown): the least useful one (see neighbor_worse()) if it is
+ * stale or further from the sink than the new one, otherwise NULL.
+ */
+static struct routingtable_item * neighbor_victim(struct routingtable *t, uint16_t hop_count){
+    struct routingtable_item *i, *victim = NULL;
+    clock_time_t now = clock_time();
+
+    for(i = routing_table_neighbor_first(t); i != NULL; i = routing_table_neighbor_next(t, i)) {
+        if(victim == NULL || neighbor_worse(i, victim, now))
+            victim = i;
+    }
+
+    if(victim == NULL || neighbor_stale(victim, now))
+        return victim;
+    if(hop_count == 0 || neighbor_hops(victim) <= hop_count)
+        return NULL;
+    return victim;
+}
+
+void routing_table_neighbor_remove(struct routingtable *t, struct routingtable_item *i){
+    routing_table_best_removed(t, i);
+    routing_table_neighbor_unlink(t, i);
+    weight_estimator_record_free(t->bcp_connection, i);
+    memb_free(t->memb, i);
+}
+
+struct routingtable_item * routing_table_neighbor_add(struct routingtable *t,
+                               const rimeaddr_t * addr, uint16_t hop_count){
+    struct routingtable_item *i;
+
+    // Allocate memory for the new record
+    i = memb_alloc(t->memb);
+
+    if(i == NULL){
+        i = neighbor_victim(t, hop_count);
+
+        //Failed to allocate memory
+        if(i == NULL)
+            return NULL;
+
+        PRINTF("DEBUG: Routing table is full, node[%d].[%d] replaces node[%d].[%d]\n",
+                addr->u8[0], addr->u8[1], i->neighbor.u8[0], i->neighbor.u8[1]);
+        routing_table_neighbor_remove(t, i);
+        i = memb_alloc(t->memb);
+    }
+
+    // Set default attributes
+    i->next = NULL;
+    rimeaddr_copy(&(i->neighbor), addr);
+    i->backpressure = 0;
+    i->forwardable = 0;
+    i->hop_count = hop_count;
+    i->srtt = i->rttvar = 0;
+    i->last_heard = clock_time();
+    i->tx_seq = random_rand();
+    i->rx_valid = 0;
+
+    //Ask weight estimator to initialize its fields
+    weight_estimator_record_init(i);
+
+    //Insert the new record
+    routing_table_neighbor_link(t, i);
+    return i;
+}
+
+int routing_table_neighbor_purge(struct routingtable *t){
+    struct routingtable_item *i;
+    clock_time_t now = clock_time();
+    int removed = 0;
+
+    //Removing a record may move the others (see bcp_routing_table_hash.c),
+    //so the walk starts over after every removal
+    i = routing_table_neighbor_first(t);
+    while(i != NULL) {
+        if(neighbor_stale(i, now)){
+            PRINTF("DEBUG: Neighbor[%d].[%d] has not been heard for a while, removing it\n",
+                    i->neighbor.u8[0], i->neighbor.u8[1]);
+            routing_table_neighbor_remove(t, i);
+            removed++;
+            i = routing_table_neighbor_first(t);
+        }else{
+            i = routing_table_neighbor_next(t, i);
+        }
+    }
+    return removed;
+}
@@ -3,9 +3,12 @@
  *         Default implementation for the weight estimator
  *         
  *         In this implementation the weight is calculated based on the orginal
- *         backpressure weight equation (delta queuelogs).
- *          
- * 
+ *         backpressure weight equation: (delta queuelogs - V * ETX) * rate.
+ *         The queue differential can be biased by the hop gradient, see 
+ *         WEIGHT_HOP_V.
+ *         ETX (expected number of transmissions) and the packet transmission 
+ *         time (1 / rate) of every neighbor are exponentially weighted moving 
+ *         averages of the samples given by weight_estimator_sent().
  * 
  */
 #include "bcp_weight_estimator.h"
@@ -33,33 +36,52 @@
  */
 struct routingtable_item_bcp {
   struct routingtable_item item;
+  //Expected number of transmissions to this neighbor, times 100
+  uint16_t link_etx;
+  //Average time to deliver a packet to this neighbor, zero until the first sample
+  clock_time_t link_packet_tx_time;
 };
 
 
 
 //Memory allocation for the routing table. This is defined here because 
 //weight estimators may require to add extra columns to the routingtable_item 
-MEMB(routing_table_memb, struct routingtable_item_bcp, MAX_ROUTING_TABLE_SIZE);
+BCP_MEMB(routing_table_memb, struct routingtable_item_bcp, MAX_ROUTING_TABLE_SIZE);
 
 
 
 /*********************************BCP PUBLIC FUNCTION**************************/
 int weight_estimator_getWeight(struct bcp_conn *c, struct routingtable_item * it){
     struct routingtable_item_bcp * i = (struct routingtable_item_bcp *) it;
-    int w = 0;
+    long w = 0;
+    clock_time_t tx_time = i->link_packet_tx_time;
     
+    //A neighbor never used is assumed to deliver a packet within RETX_TIME, 
+    //like any neighbor before its first sample
+    if(tx_time == 0)
+        tx_time = (clock_time_t) RETX_TIME;
     
-    //Calculate the weight 
-    w = (int) bcp_queue_length(&c->packet_queue);
+    //Calculate the weight: (delta queuelogs - V * ETX) * rate. ETX is kept 
+    //times 100 and the rate is counted in packets per second.
+    w = (long) bcp_queue_length(&c->packet_queue);
     w -= i->item.backpressure;
+    w -= (long) WEIGHT_HOP_V * hop_counter_gradient(c, i->item.hop_count);
+    w = w * 100 - (long) LINK_LOSS_V * i->link_etx;
+    //Signed division: clock_time_t is unsigned, and as wide as long on some platforms
+    w = w * CLOCK_SECOND / (long) tx_time;
+    
+    if(w > LINK_MAX_WEIGHT)
+        w = LINK_MAX_WEIGHT;
+    else if(w < -LINK_MAX_WEIGHT)
+        w = -LINK_MAX_WEIGHT;
   
     return (int)w; 
 }
 
 void weight_estimator_sent(struct routingtable_item * it, 
                                 struct bcp_queue_item *qi, 
-                                uint16_t attempts){
-    uint16_t new_link_packet_tx_time;
+                                uint16_t attempts,
+                                clock_time_t tx_time){
     struct routingtable_item_bcp * i = (struct routingtable_item_bcp *) it;
     
     PRINTF("DEBUG: Weight estimator updates routingtable_item metrics. Neighbor[%d].[%d], Attempts=[%d]\n"
@@ -68,20 +90,42 @@ void weight_estimator_sent(struct routingtable_item * it,
         , attempts
         );
     
+    if(tx_time == 0)
+        tx_time = 1;
+    
+    //Decay the link loss estimate
+    i->link_etx = ((uint32_t) LINK_LOSS_ALPHA * i->link_etx 
+                    + (uint32_t)(100 - LINK_LOSS_ALPHA) * 100 * attempts) / 100;
+    
+    //Decay the transmission time estimate; the first sample is taken as is
+    if(i->link_packet_tx_time == 0)
+        i->link_packet_tx_time = tx_time;
+    else
+        i->link_packet_tx_time = (LINK_EST_ALPHA * i->link_packet_tx_time 
+                                    + (10 - LINK_EST_ALPHA) * tx_time) / 10;
 }
 
 void weight_estimator_init(struct bcp_conn *c){
-    c->routing_table.memb = &routing_table_memb;
-    memb_init(&routing_table_memb);
+    c->routing_table.memb = routing_table_memb_init(c);
 }
 
 void weight_estimator_record_init(struct routingtable_item * it){
-    struct routingtable_item_bcp * i =  it;
+    struct routingtable_item_bcp * i = (struct routingtable_item_bcp *) it;
+    
+    //One transmission per packet until we know better
+    i->link_etx = 100;
+    i->link_packet_tx_time = 0;
+}
+
+void weight_estimator_record_free(struct bcp_conn *c, struct routingtable_item * it){
     
 }
 
 void weight_estimator_print_item(struct bcp_conn *c, struct routingtable_item *item){
-    struct routingtable_item_bcp * i = item;
+    struct routingtable_item_bcp * i = (struct routingtable_item_bcp *) item;
     
-    PRINTF("Weight: %d\n", weight_estimator_getWeight(c, item));
+    PRINTF("ETX: %d.%02d, tx time: %d, Weight: %d\n", 
+            i->link_etx / 100, i->link_etx % 100,
+            (int) i->link_packet_tx_time,
+            weight_estimator_getWeight(c, item));
 }
\ No newline at end of file
@@ -35,17 +35,29 @@ void weight_estimator_init(struct bcp_conn *c);
  *      table to ask the weight estimator to initialize its custom fields. 
  */
 void weight_estimator_record_init(struct routingtable_item * it);
+/**
+ * \breif Informs the weight estimator that a record leaves the routing table
+ * 
+ * \param c the bcp connection of the routing table
+ * \param it routing table record, freed after this call
+ */
+void weight_estimator_record_free(struct bcp_conn *c, struct routingtable_item * it);
 
 /**
- * \breif Informs the weight estimators that a new packet has been successfully sent. 
+ * \breif Informs the weight estimators that a packet has been sent to a neighbor. 
  * 
  * \param it the routing table record for the destination address
  * \param i the packet record in the packet queue of the bcp connection
- * \param attempts the number of required transactions 
+ * \param attempts the number of required transactions. When the neighbor did 
+ *        not acknowledge any of them (the packet is sent to another neighbor), 
+ *        this is one more than the number of transactions.
+ * \param tx_time the time between the first transaction and the ACK, or the 
+ *        decision to use another neighbor
  */
 void weight_estimator_sent(struct routingtable_item * it, 
                                 struct bcp_queue_item *i, 
-                                uint16_t attempts);
+                                uint16_t attempts,
+                                clock_time_t tx_time);
 
 /**
  * \breif Calculates the weight for the given neighbor
@@ -0,0 +1,111 @@
+/**
+ * \file
+ *         Encoder and decoder of the BCP data packets (see \ref bcp_wire.h).
+ */
+#include "bcp_wire.h"
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define BACKPRESSURE_MAX ((1 << BCP_WIRE_BACKPRESSURE_BITS) - 1)
+#define EXT_SHIFT BCP_WIRE_BACKPRESSURE_BITS
+#define EXT_MASK ((1 << BCP_WIRE_EXT_BITS) - 1)
+#define EXPONENT_SHIFT (EXT_SHIFT + BCP_WIRE_EXT_BITS)
+#define EXPONENT_MAX 15
+#define MANTISSA_SHIFT 16
+
+/**
+ * \return the delay as an exponent (bits 12-15) and a 16 bit mantissa (bits 16-31).
+ * Delays longer than 0xffff << 15 ticks are saturated.
+ */
+static uint32_t pack_delay(uint32_t d){
+    uint32_t e = 0;
+
+    while(d > 0xffff){
+        d >>= 1;
+        e++;
+    }
+    if(e > EXPONENT_MAX){
+        e = EXPONENT_MAX;
+        d = 0xffff;
+    }
+    return (e << EXPONENT_SHIFT) | (d << MANTISSA_SHIFT);
+}
+
+static uint32_t unpack_delay(uint32_t w){
+    return (w >> MANTISSA_SHIFT) << ((w >> EXPONENT_SHIFT) & EXPONENT_MAX);
+}
+
+uint16_t bcp_wire_encode(const struct bcp_queue_item *i, uint8_t ext, uint16_t hops, uint8_t seq, void *buf){
+    uint8_t *p = buf;
+    uint32_t w;
+    uint16_t bp = i->hdr.bcp_backpressure;
+    int k;
+
+    memcpy(p, &i->hdr.origin, sizeof(rimeaddr_t));
+    p += sizeof(rimeaddr_t);
+    *p++ = i->hdr.origin_seq;
+    *p++ = i->hdr.origin_seq >> 8;
+    memcpy(p, i->data, MAX_USER_PACKET_SIZE);
+    p += MAX_USER_PACKET_SIZE;
+
+    w = bp > BACKPRESSURE_MAX ? BACKPRESSURE_MAX : bp;
+    w |= (uint32_t)(ext & EXT_MASK) << EXT_SHIFT;
+    w |= pack_delay(i->hdr.delay);
+    for(k = 0; k < 4; k++)
+        *p++ = w >> (8 * k);
+    *p++ = hops > 0xff ? 0xff : hops;
+    *p = seq;
+
+    return BCP_WIRE_DATA_LENGTH;
+}
+
+int bcp_wire_decode(const void *buf, uint16_t len, struct bcp_queue_item *i, uint8_t *ext, uint16_t *hops, uint8_t *seq){
+    const uint8_t *p = buf;
+    uint32_t w = 0;
+    int k;
+
+    if(len != BCP_WIRE_DATA_LENGTH){
+        PRINTF("ERROR: Data packet of %d bytes cannot be decoded\n", len);
+        return 0;
+    }
+
+    i->next = NULL;
+    i->hdr.packet_length = sizeof(struct bcp_queue_item);
+    memcpy(&i->hdr.origin, p, sizeof(rimeaddr_t));
+    p += sizeof(rimeaddr_t);
+    i->hdr.origin_seq = p[0] | (p[1] << 8);
+    i->hdr.merged = 0;
+    p += 2;
+    memcpy(i->data, p, MAX_USER_PACKET_SIZE);
+    p += MAX_USER_PACKET_SIZE;
+
+    for(k = 0; k < 4; k++)
+        w |= (uint32_t)*p++ << (8 * k);
+    i->hdr.bcp_backpressure = w & BACKPRESSURE_MAX;
+    i->hdr.delay = unpack_delay(w);
+    *ext = (w >> EXT_SHIFT) & EXT_MASK;
+    *hops = *p++;
+    *seq = *p;
+
+    return 1;
+}
+
+int bcp_wire_id(const void *buf, uint16_t len, rimeaddr_t *origin, uint16_t *origin_seq, uint8_t *seq){
+    const uint8_t *p = buf;
+
+    if(len != BCP_WIRE_DATA_LENGTH)
+        return 0;
+
+    memcpy(origin, p, sizeof(rimeaddr_t));
+    p += sizeof(rimeaddr_t);
+    *origin_seq = p[0] | (p[1] << 8);
+    *seq = ((const uint8_t *)buf)[BCP_WIRE_DATA_LENGTH - 1];
+    return 1;
+}
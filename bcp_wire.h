@@ -0,0 +1,73 @@
+/**
+ * \file
+ *         On-air format of the BCP data packets.
+ *
+ *         Only the fields needed by the next hop are sent:
+ *
+ *           origin (2 bytes) | origin_seq (2 bytes) | data (MAX_USER_PACKET_SIZE bytes) | word (4 bytes) | hops (1 byte) | seq (1 byte)
+ *
+ *         origin_seq is the sequence number given to the packet by its origin,
+ *         sent least significant byte first. With the origin it identifies the
+ *         packet on every hop.
+ *         The 32 bit word is sent least significant byte first and packs,
+ *         from the least significant bit:
+ *           - the backpressure (BCP_WIRE_BACKPRESSURE_BITS, saturated)
+ *           - the extension bits owned by the BCP extender (BCP_WIRE_EXT_BITS,
+ *             fusion sends its fusion packet flag, hdr.merged, and CID there)
+ *           - the delay as a 4 bit exponent and a 16 bit mantissa
+ *
+ *         hops is the hop count of the sender (see hop_counter.h), saturated.
+ *         seq is the sequence number given to the packet by the sender of this
+ *         hop, counted per receiver; the ACK of the packet carries it back.
+ *
+ *         The list pointer, the packet length and lastProcessTime of the queue
+ *         item are local to the node and never sent.
+ */
+#ifndef BCP_WIRE_H
+#define	BCP_WIRE_H
+
+#include "bcp_queue.h"
+
+#define BCP_WIRE_BACKPRESSURE_BITS 7
+#define BCP_WIRE_EXT_BITS 5
+
+//Length of an encoded data packet
+#define BCP_WIRE_DATA_LENGTH (sizeof(rimeaddr_t) + MAX_USER_PACKET_SIZE + 8)
+
+/**
+ * \breif Encodes the given queue item for the radio
+ * \param i the queue item
+ * \param ext the extension bits sent along with the packet
+ * \param hops the hop count of the sender
+ * \param seq the sequence number of the packet
+ * \param buf a buffer of BCP_WIRE_DATA_LENGTH bytes
+ * \return the length of the encoded packet
+ */
+uint16_t bcp_wire_encode(const struct bcp_queue_item *i, uint8_t ext, uint16_t hops, uint8_t seq, void *buf);
+
+/**
+ * \breif Decodes a data packet received from the radio
+ * \param buf the received packet
+ * \param len the length of the received packet
+ * \param i the queue item to fill in. Only the fields of struct bcp_queue_item
+ *        are written; lastProcessTime is left to the caller.
+ * \param ext set to the extension bits of the packet
+ * \param hops set to the hop count of the sender
+ * \param seq set to the sequence number of the packet
+ * \return zero if the packet is not a valid data packet, non-zero otherwise.
+ */
+int bcp_wire_decode(const void *buf, uint16_t len, struct bcp_queue_item *i, uint8_t *ext, uint16_t *hops, uint8_t *seq);
+
+/**
+ * \breif Reads the identity and the sequence number of a data packet without 
+ *        decoding it
+ * \param buf the received packet
+ * \param len the length of the received packet
+ * \param origin set to the origin of the packet
+ * \param origin_seq set to the sequence number given to the packet by its origin
+ * \param seq set to the sequence number of the packet
+ * \return zero if the packet is not a valid data packet, non-zero otherwise.
+ */
+int bcp_wire_id(const void *buf, uint16_t len, rimeaddr_t *origin, uint16_t *origin_seq, uint8_t *seq);
+
+#endif	/* BCP_WIRE_H */
@@ -0,0 +1,214 @@
+/**
+ * \file
+ *         Runs a network of Contiki native processes on one host.
+ *
+ *         Creates the shared memory radio medium, fills its link matrix and
+ *         forks one process of the given program per node with FUSION_NODE_ID
+ *         set to 1..n. The output of every node goes to its own log file.
+ *         Stopping the launcher (SIGINT/SIGTERM) stops the nodes and removes
+ *         the medium.
+ *
+ *         Without a matrix file all nodes hear each other with the loss and
+ *         delay given on the command line. A matrix file lists the directed
+ *         links, one per line: "src dst loss delay_ms" where loss is a
+ *         probability; '#' starts a comment and unlisted links do not exist.
+ */
+#include "shm-medium.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+static pid_t pids[SHM_MEDIUM_MAX_NODES];
+static int nodes = 10;
+static volatile sig_atomic_t stop;
+
+static void usage(const char *prog){
+    fprintf(stderr,
+            "Usage: %s [options] program [args...]\n"
+            "  -n nodes   number of nodes (default %d, max %d)\n"
+            "  -l loss    loss probability of every link (default 0)\n"
+            "  -d ms      propagation delay of every link (default 0)\n"
+            "  -m file    link matrix, overrides -l/-d\n"
+            "  -o dir     directory of the node logs (default .)\n"
+            "  -N name    name of the shared memory segment (default %s)\n",
+            prog, nodes, SHM_MEDIUM_MAX_NODES, SHM_MEDIUM_NAME);
+}
+
+static uint16_t to_loss(double p){
+    if(p <= 0)
+        return 0;
+    if(p >= 1)
+        return SHM_MEDIUM_NO_LINK;
+    return (uint16_t)(p * SHM_MEDIUM_LOSS_SCALE + 0.5);
+}
+
+static int load_matrix(struct shm_medium *m, const char *path){
+    FILE *f = fopen(path, "r");
+    char line[256];
+    int src, dst, delay, n = 0, lineno = 0;
+    double loss;
+
+    if(f == NULL){
+        perror(path);
+        return -1;
+    }
+    for(src = 0; src < nodes; src++)
+        for(dst = 0; dst < nodes; dst++)
+            m->links[src][dst].loss = SHM_MEDIUM_NO_LINK;
+
+    while(fgets(line, sizeof(line), f) != NULL){
+        lineno++;
+        if(line[strspn(line, " \t")] == '#' || line[strspn(line, " \t\r\n")] == 0)
+            continue;
+        if(sscanf(line, "%d %d %lf %d", &src, &dst, &loss, &delay) != 4 ||
+           src < 1 || src > nodes || dst < 1 || dst > nodes || delay < 0){
+            fprintf(stderr, "%s:%d: invalid link\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        m->links[src - 1][dst - 1].loss = to_loss(loss);
+        m->links[src - 1][dst - 1].delay_ms = delay > 0xffff ? 0xffff : delay;
+        n++;
+    }
+    fclose(f);
+    printf("%d links loaded from %s\n", n, path);
+    return 0;
+}
+
+static pid_t start_node(int id, const char *medium, const char *logdir, char **argv){
+    char buf[512];
+    pid_t pid = fork();
+    int fd;
+
+    if(pid != 0)
+        return pid;
+
+    snprintf(buf, sizeof(buf), "%d", id);
+    setenv("FUSION_NODE_ID", buf, 1);
+    setenv("FUSION_MEDIUM", medium, 1);
+
+    snprintf(buf, sizeof(buf), "%s/node-%d.log", logdir, id);
+    fd = open(buf, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        perror(buf);
+        _exit(1);
+    }
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+    fd = open("/dev/null", O_RDONLY);
+    dup2(fd, STDIN_FILENO);
+    close(fd);
+
+    execvp(argv[0], argv);
+    perror(argv[0]);
+    _exit(1);
+}
+
+static void on_signal(int sig){
+    stop = 1;
+}
+
+int main(int argc, char **argv){
+    const char *medium_name = SHM_MEDIUM_NAME, *matrix = NULL, *logdir = ".";
+    struct shm_medium *m;
+    struct sigaction sa;
+    double loss = 0;
+    int delay = 0, running = 0, status, i, j, c, fd;
+    pid_t pid;
+
+    while((c = getopt(argc, argv, "+n:l:d:m:o:N:h")) != -1){
+        switch(c){
+        case 'n': nodes = atoi(optarg); break;
+        case 'l': loss = atof(optarg); break;
+        case 'd': delay = atoi(optarg); break;
+        case 'm': matrix = optarg; break;
+        case 'o': logdir = optarg; break;
+        case 'N': medium_name = optarg; break;
+        default:
+            usage(argv[0]);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+    if(optind >= argc || nodes < 1 || nodes > SHM_MEDIUM_MAX_NODES){
+        usage(argv[0]);
+        return 1;
+    }
+
+    shm_unlink(medium_name);
+    fd = shm_open(medium_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0 || ftruncate(fd, sizeof(struct shm_medium)) < 0){
+        perror(medium_name);
+        return 1;
+    }
+    m = mmap(NULL, sizeof(struct shm_medium), PROT_READ | PROT_WRITE,
+             MAP_SHARED, fd, 0);
+    close(fd);
+    if(m == MAP_FAILED){
+        perror("mmap");
+        shm_unlink(medium_name);
+        return 1;
+    }
+
+    m->nodes = nodes;
+    for(i = 0; i < nodes; i++)
+        for(j = 0; j < nodes; j++){
+            m->links[i][j].loss = to_loss(loss);
+            m->links[i][j].delay_ms = delay;
+        }
+    if(matrix != NULL && load_matrix(m, matrix) < 0){
+        shm_unlink(medium_name);
+        return 1;
+    }
+    atomic_store_explicit(&m->magic, SHM_MEDIUM_MAGIC, memory_order_release);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    for(i = 0; i < nodes; i++){
+        pids[i] = start_node(i + 1, medium_name, logdir, argv + optind);
+        if(pids[i] < 0){
+            perror("fork");
+            stop = 1;
+            break;
+        }
+        running++;
+    }
+    printf("%d nodes running on %s, logs in %s\n", running, medium_name, logdir);
+
+    while(running > 0){
+        if(stop){
+            for(i = 0; i < nodes; i++)
+                if(pids[i] > 0)
+                    kill(pids[i], SIGTERM);
+        }
+        pid = waitpid(-1, &status, 0);
+        if(pid < 0){
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        for(i = 0; i < nodes; i++)
+            if(pids[i] == pid){
+                pids[i] = 0;
+                running--;
+                if(!stop)
+                    printf("node %d exited (status %d)\n", i + 1, status);
+            }
+    }
+
+    for(i = 0; i < nodes; i++)
+        printf("node %d sent %u frames\n", i + 1,
+               atomic_load(&m->outbox[i].head));
+    shm_unlink(medium_name);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/**
+ * \file
+ *         Layout of the shared memory radio medium used to emulate a network
+ *         of Contiki native processes on one host (see shm-radio.c and
+ *         emu-launch.c).
+ *
+ *         Every node owns one outbox, a ring of frames it is the only writer
+ *         of. Receivers keep their own read cursor into the outbox of every
+ *         neighbor, so the medium needs no lock: a slot carries a sequence
+ *         number which is odd while the slot is being written and lets a
+ *         reader detect that the slot has been overwritten while copying it.
+ *
+ *         The link matrix gives the loss probability and the propagation
+ *         delay of every directed link.
+ */
+#ifndef SHM_MEDIUM_H
+#define	SHM_MEDIUM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define SHM_MEDIUM_NAME "/fusion-medium"
+#define SHM_MEDIUM_MAGIC 0x46534d31
+
+#define SHM_MEDIUM_MAX_NODES 256
+#define SHM_MEDIUM_RING_SIZE 64 //Frames kept in every outbox
+#define SHM_MEDIUM_MTU 256
+
+//Loss is expressed in 1/10000; a loss of SHM_MEDIUM_NO_LINK means no link at all
+#define SHM_MEDIUM_LOSS_SCALE 10000
+#define SHM_MEDIUM_NO_LINK SHM_MEDIUM_LOSS_SCALE
+
+/**
+ * \brief      One frame of an outbox
+ */
+struct shm_medium_slot {
+  //2 * frame index + 1 while the slot is written, 2 * frame index + 2 once done
+  _Atomic uint32_t seq;
+  uint16_t len;
+  //Transmission time (CLOCK_MONOTONIC) in microseconds
+  uint64_t time_us;
+  uint8_t data[SHM_MEDIUM_MTU];
+};
+
+/**
+ * \brief      The frames sent by one node
+ */
+struct shm_medium_outbox {
+  //Index of the next frame to be written
+  _Atomic uint32_t head;
+  //Keep the head of every outbox in its own cache line
+  uint8_t pad[60];
+  struct shm_medium_slot slots[SHM_MEDIUM_RING_SIZE];
+};
+
+/**
+ * \brief      A directed link between two nodes
+ */
+struct shm_medium_link {
+  uint16_t loss;
+  uint16_t delay_ms;
+};
+
+/**
+ * \brief      The shared memory segment
+ */
+struct shm_medium {
+  //Written last by the launcher once the segment has been initialized
+  _Atomic uint32_t magic;
+  uint16_t nodes;
+  //links[src][dst], indexed by node id - 1
+  struct shm_medium_link links[SHM_MEDIUM_MAX_NODES][SHM_MEDIUM_MAX_NODES];
+  struct shm_medium_outbox outbox[SHM_MEDIUM_MAX_NODES];
+};
+
+/**
+ * \return the current time of the monotonic clock shared by all processes
+ */
+static inline uint64_t shm_medium_now_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * \breif Appends a frame to the given outbox. Must only be called by the owner
+ *        of the outbox.
+ */
+static inline void shm_medium_put(struct shm_medium_outbox *o,
+                                  const void *data, uint16_t len){
+    uint32_t idx = atomic_load_explicit(&o->head, memory_order_relaxed);
+    struct shm_medium_slot *s = &o->slots[idx % SHM_MEDIUM_RING_SIZE];
+
+    if(len > SHM_MEDIUM_MTU)
+        len = SHM_MEDIUM_MTU;
+
+    atomic_store_explicit(&s->seq, 2 * idx + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s->len = len;
+    s->time_us = shm_medium_now_us();
+    memcpy(s->data, data, len);
+    atomic_store_explicit(&s->seq, 2 * idx + 2, memory_order_release);
+    atomic_store_explicit(&o->head, idx + 1, memory_order_release);
+}
+
+/**
+ * \breif Reads the next frame of an outbox
+ * \param o the outbox of the sender
+ * \param cursor the read cursor of the receiver for this outbox
+ * \param delay_us the frame is only returned once it is older than this delay
+ * \param buf a buffer of SHM_MEDIUM_MTU bytes
+ * \param len set to the length of the frame
+ * \return 1 if a frame has been copied into buf, 0 if no frame is due yet,
+ *         -1 if frames have been overwritten before they could be read.
+ */
+static inline int shm_medium_get(struct shm_medium_outbox *o, uint32_t *cursor,
+                                 uint64_t delay_us, void *buf, uint16_t *len){
+    uint32_t head = atomic_load_explicit(&o->head, memory_order_acquire);
+    struct shm_medium_slot *s;
+    uint32_t seq;
+    int due;
+
+    if(*cursor == head)
+        return 0;
+    if(head - *cursor > SHM_MEDIUM_RING_SIZE){
+        *cursor = head - SHM_MEDIUM_RING_SIZE;
+        return -1;
+    }
+
+    s = &o->slots[*cursor % SHM_MEDIUM_RING_SIZE];
+    seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+    if(seq != 2 * *cursor + 2){
+        (*cursor)++;
+        return -1;
+    }
+
+    *len = s->len;
+    due = s->time_us + delay_us <= shm_medium_now_us() && *len <= SHM_MEDIUM_MTU;
+    if(due)
+        memcpy(buf, s->data, *len);
+
+    atomic_thread_fence(memory_order_acquire);
+    if(atomic_load_explicit(&s->seq, memory_order_relaxed) != seq){
+        (*cursor)++;
+        return -1;
+    }
+    if(!due)
+        return 0;
+
+    (*cursor)++;
+    return 1;
+}
+
+#endif	/* SHM_MEDIUM_H */
@@ -0,0 +1,240 @@
+/**
+ * \file
+ *         Radio driver of the Contiki native platform exchanging frames with
+ *         the other emulated nodes through the shared memory medium created
+ *         by emu-launch.
+ *
+ *         The node id (1..n) is read from the FUSION_NODE_ID environment
+ *         variable and becomes the rime address of the node, i.e. node 1 is
+ *         1.0 which is the sink of main.c. Frames are whatever the RDC layer
+ *         hands to the radio, so broadcast and unicast traffic of the Rime
+ *         stack travel unchanged.
+ */
+#include "contiki.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/rime.h"
+#include "lib/random.h"
+#include "shm-radio.h"
+#include "shm-medium.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+static struct shm_medium *medium;
+static uint16_t node; //Our index in the medium, i.e. node id - 1
+static uint32_t cursors[SHM_MEDIUM_MAX_NODES];
+
+static uint8_t tx_buf[SHM_MEDIUM_MTU];
+static uint16_t tx_len;
+static uint8_t rx_buf[SHM_MEDIUM_MTU];
+static uint16_t rx_len;
+
+static char radio_is_on = 1;
+
+//Frames overwritten in an outbox before we could read them
+static unsigned long overruns;
+
+PROCESS(shm_radio_process, "Shared memory radio");
+/*---------------------------------------------------------------------------*/
+static int
+init(void)
+{
+    const char *name = getenv("FUSION_MEDIUM");
+    const char *id = getenv("FUSION_NODE_ID");
+    rimeaddr_t addr;
+    uint16_t i;
+    int fd;
+
+    if(name == NULL)
+        name = SHM_MEDIUM_NAME;
+    if(id == NULL || atoi(id) < 1 || atoi(id) > SHM_MEDIUM_MAX_NODES){
+        fprintf(stderr, "shm-radio: FUSION_NODE_ID must be in 1..%d\n",
+                SHM_MEDIUM_MAX_NODES);
+        return 0;
+    }
+    node = atoi(id) - 1;
+
+    fd = shm_open(name, O_RDWR, 0);
+    if(fd < 0){
+        perror("shm-radio: shm_open");
+        return 0;
+    }
+    medium = mmap(NULL, sizeof(struct shm_medium), PROT_READ | PROT_WRITE,
+                  MAP_SHARED, fd, 0);
+    close(fd);
+    if(medium == MAP_FAILED ||
+       atomic_load_explicit(&medium->magic, memory_order_acquire) != SHM_MEDIUM_MAGIC ||
+       node >= medium->nodes){
+        fprintf(stderr, "shm-radio: medium %s is not usable by node %d\n",
+                name, node + 1);
+        medium = NULL;
+        return 0;
+    }
+
+    //Frames sent before we came up are never heard
+    for(i = 0; i < medium->nodes; i++)
+        cursors[i] = atomic_load_explicit(&medium->outbox[i].head,
+                                          memory_order_acquire);
+
+    memset(&addr, 0, sizeof(rimeaddr_t));
+    addr.u8[0] = (node + 1) & 0xff;
+    addr.u8[1] = (node + 1) >> 8;
+    rimeaddr_set_node_addr(&addr);
+    random_init(node + 1);
+
+    PRINTF("shm-radio: node %d.%d attached to %s\n", addr.u8[0], addr.u8[1], name);
+
+    process_start(&shm_radio_process, NULL);
+    return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+prepare(const void *payload, unsigned short payload_len)
+{
+    if(payload_len > SHM_MEDIUM_MTU)
+        return RADIO_TX_ERR;
+    memcpy(tx_buf, payload, payload_len);
+    tx_len = payload_len;
+    return RADIO_TX_OK;
+}
+/*---------------------------------------------------------------------------*/
+static int
+transmit(unsigned short transmit_len)
+{
+    if(medium == NULL || !radio_is_on)
+        return RADIO_TX_ERR;
+    shm_medium_put(&medium->outbox[node], tx_buf, tx_len);
+    return RADIO_TX_OK;
+}
+/*---------------------------------------------------------------------------*/
+static int
+send(const void *payload, unsigned short payload_len)
+{
+    int ret = prepare(payload, payload_len);
+    if(ret != RADIO_TX_OK)
+        return ret;
+    return transmit(payload_len);
+}
+/*---------------------------------------------------------------------------*/
+static int
+read(void *buf, unsigned short buf_len)
+{
+    uint16_t len = rx_len;
+
+    if(len > buf_len)
+        len = buf_len;
+    memcpy(buf, rx_buf, len);
+    rx_len = 0;
+    return len;
+}
+/*---------------------------------------------------------------------------*/
+static int
+channel_clear(void)
+{
+    return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+receiving_packet(void)
+{
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+pending_packet(void)
+{
+    return rx_len > 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+on(void)
+{
+    radio_is_on = 1;
+    return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+off(void)
+{
+    radio_is_on = 0;
+    return 1;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \breif Delivers to the RDC layer every frame of our neighbors that has
+ *        traveled through its link by now
+ */
+static void
+poll_medium(void)
+{
+    struct shm_medium_link *link;
+    uint16_t i;
+    int r;
+
+    for(i = 0; i < medium->nodes; i++){
+        link = &medium->links[i][node];
+        if(i == node || link->loss >= SHM_MEDIUM_NO_LINK)
+            continue;
+
+        while((r = shm_medium_get(&medium->outbox[i], &cursors[i],
+                                  (uint64_t)link->delay_ms * 1000,
+                                  rx_buf, &rx_len)) != 0){
+            if(r < 0){
+                overruns++;
+                PRINTF("shm-radio: frames of node %d lost to overrun (%lu)\n",
+                       i + 1, overruns);
+                continue;
+            }
+            if(!radio_is_on || random_rand() % SHM_MEDIUM_LOSS_SCALE < link->loss){
+                rx_len = 0;
+                continue;
+            }
+
+            packetbuf_clear();
+            packetbuf_set_datalen(read(packetbuf_dataptr(), PACKETBUF_SIZE));
+            NETSTACK_RDC.input();
+        }
+    }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shm_radio_process, ev, data)
+{
+    static struct etimer et;
+
+    PROCESS_BEGIN();
+
+    while(1){
+        etimer_set(&et, SHM_RADIO_POLL_INTERVAL);
+        PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+        poll_medium();
+    }
+
+    PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+const struct radio_driver shm_radio_driver =
+{
+    init,
+    prepare,
+    transmit,
+    send,
+    read,
+    channel_clear,
+    receiving_packet,
+    pending_packet,
+    on,
+    off,
+};
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,18 @@
+/**
+ * \file
+ *         Radio driver of the Contiki native platform exchanging frames with
+ *         the other emulated nodes through the shared memory medium.
+ */
+#ifndef SHM_RADIO_H
+#define	SHM_RADIO_H
+
+#include "dev/radio.h"
+
+//How often the medium is checked for incoming frames
+#ifndef SHM_RADIO_POLL_INTERVAL
+#define SHM_RADIO_POLL_INTERVAL (CLOCK_SECOND / 200)
+#endif
+
+extern const struct radio_driver shm_radio_driver;
+
+#endif	/* SHM_RADIO_H */
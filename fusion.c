@@ -3,10 +3,21 @@
 #include "bcp_queue.h"
 #include "bcp_queue_allocator.h" //To customize the queue item 
 #include "bcp_extend.h" //To extend BCP operations
+#include "bcp_wire.h" //To send the fusion fields over the air
 #include "fusion_energy_control.h" //To get energy budgets for sending and fusion
+#include "fusion_operator.h" //To merge the readings of the fused packets
+#include "fusion_config.h"
 #include "lib/random.h"
+#include <stdio.h>
 
-#define NUM_CID 2
+#if NUM_CID >= BCP_QUEUE_GROUPS
+#error "BCP_QUEUE_GROUPS must be greater than NUM_CID"
+#endif
+
+//The CID is sent in the extension bits of the data packets, next to the fused flag
+#if NUM_CID >= (1 << (BCP_WIRE_EXT_BITS - 1))
+#error "NUM_CID does not fit in the extension bits of the data packets"
+#endif
 
 #define DEBUG 0
 #if DEBUG
@@ -51,8 +62,8 @@ struct fusion_queue_item {
 
 
 
-//Memory allocation for the routing table. This is defined here because 
-MEMB(fusion_packet_queue_memb, struct fusion_queue_item, MAX_PACKET_QUEUE_SIZE);
+//Memory allocation for the packet queue of every connection. This is defined here because 
+BCP_MEMB(fusion_packet_queue_memb, struct fusion_queue_item, MAX_PACKET_QUEUE_SIZE);
 static unsigned short CID = 255;
 
 
@@ -70,6 +81,18 @@ static uint16_t getCID(){
     return CID;
 }
 
+/**
+ * \breif Makes the given packet a new fusion packet of this node: its origin 
+ * is this node and its origin sequence number follows the ones of the packets 
+ * this node generates, so that no other packet has the same identity.
+ */
+static void setFusionOrigin(struct bcp_conn *c, struct fusion_queue_item * fItm){
+    fItm->hdr.fused = 1;
+    fItm->hdr.bcp_header.merged = 1;
+    rimeaddr_copy(&fItm->hdr.bcp_header.origin, &rimeaddr_node_addr);
+    fItm->hdr.bcp_header.origin_seq = c->origin_seq++;
+}
+
 /**
  * \return true if the given packet is a fusion packet. Otherwise, false.
  */
@@ -78,21 +101,20 @@ static bool isFusionPacket(struct bcp_queue_item* itm){
     struct fusion_queue_item * fItm = ( struct fusion_queue_item *) itm;
     
     //If it is a fusion packet 
-    return (fItm->hdr.bcp_header.origin.u8[0] == 250 
-            && fItm->hdr.bcp_header.origin.u8[1] == 250);
+    return fItm->hdr.bcp_header.merged != 0;
 }
 
 struct bcp_queue_item* beforeSending(struct bcp_conn *c,  struct bcp_queue_item* itm){
     PRINTF("DEBUG: Before Sending Data \n");
     
     //Check the sending energy budget
-    if(get_sending_budget()==0)
+    if(get_sending_budget(c)==0)
         return NULL;
-    PRINTF("DEBUG: Sending Budget = %d\n",get_sending_budget() );
+    PRINTF("DEBUG: Sending Budget = %d\n",get_sending_budget(c) );
     itm->hdr.packet_length = sizeof(struct fusion_queue_item);
     
     //Update the energy consumption for the sending
-    set_consumed_sending_budget(1);
+    set_consumed_sending_budget(c, 1);
     
     return itm;
 }
@@ -113,133 +135,173 @@ static struct fusion_queue_item * getFusionQueueItem(struct bcp_queue *q, uint16
     return (struct fusion_queue_item*) bcp_queue_element(q, i);
 }
 
-static short fusionRule(struct fusion_queue_item** fusionList, int fusionItemCounter){
-    //Execute the fusion function on the fusion list
-    //In this implementation, the fusion function is max
-    return 10; //Just for testing
+/**
+ * \breif Executes the fusion operator of the group on its first 
+ *        fusionItemCounter packets
+ * \param s the merge state of the packets
+ */
+static void fusionRule(struct bcp_queue * q, uint16_t eCID, int fusionItemCounter, struct fusion_state *s){
+    struct fusion_state other;
     int m;
-    int max = 0;
-    for(m =0 ; m < fusionItemCounter; m++){
-        if (max < fusionList[m]->data){
-            max = fusionList[m]->data;
-        }
-    }
+    struct fusion_queue_item * e = (struct fusion_queue_item *) bcp_queue_group_top(q, eCID);
     
-    return max;
+    s->count = 0;
+    s->value = 0;
+    for(m =0 ; m < fusionItemCounter && e != NULL; m++){
+        fusion_state_read(eCID, e->data, isFusionPacket((struct bcp_queue_item *) e), &other);
+        if(m == 0)
+            *s = other;
+        else
+            fusion_state_merge(eCID, s, &other);
+        e = (struct fusion_queue_item *) bcp_queue_group_next(q, (struct bcp_queue_item *) e);
+    }
 }
 
-static void removeFusedPackets(struct bcp_queue * q, void** fusionList, int len){
+static void removeFusedPackets(struct bcp_queue * q, uint16_t eCID, int len){
      int m;
      for(m =0 ; m < len; m++){
-       struct fusion_queue_item * itm = (struct fusion_queue_item *) fusionList[m];
+       struct fusion_queue_item * itm = (struct fusion_queue_item *) bcp_queue_group_top(q, eCID);
        
        PRINTF("DEBUG: Removing fused packet coming from node[%d].[%d] p=%p\n", 
                      itm->hdr.bcp_header.origin.u8[0],
                      itm->hdr.bcp_header.origin.u8[1],
                      itm);
-       bcp_queue_remove(q, itm);
-       fusionList[m] = NULL;
+       bcp_queue_remove(q, (struct bcp_queue_item *) itm);
      }
 }
 
+/**
+ * \return the fusion group (the CID) of a packet pushed to the queue, or
+ * BCP_QUEUE_NO_GROUP if the packet cannot be fused in this node.
+ */
+static uint8_t fusionGroup(struct bcp_queue_item * itm){
+    struct fusion_queue_item * fItm = ( struct fusion_queue_item *) itm;
+    
+    //Packets already fused here and our own packets are never fused 
+    if(fItm->hdr.fused != 0 
+            || rimeaddr_cmp(&fItm->hdr.bcp_header.origin, &rimeaddr_node_addr)
+            || fItm->hdr.CID >= BCP_QUEUE_GROUPS)
+        return BCP_QUEUE_NO_GROUP;
+    
+    return fItm->hdr.CID;
+}
+
 
 void performFusion(struct bcp_queue * q ){
         
-        int len = bcp_queue_length(q);        
-        void* fusionList[MAX_PACKET_QUEUE_SIZE];
+        struct bcp_conn *c = q->bcp_connection;
         int fusionItemCounter;
-        int i, j, k, m, ignore, perFusion;
-        clock_time_t fusionDelay;
+        int i;
+        uint32_t fusionDelay;
+        struct fusion_state result;
         uint16_t eCID;
         
-        struct fusion_queue_item * e;
         struct fusion_queue_item * eNested;
-        struct fusion_queue_item * top;
-        
         
-        //Get the top item
-        top = bcp_queue_top(q);
-        
-        
-            
-        
-        PRINTF("DEBUG: Performing fusion on the queue. Current queue length=%d\n", len);
+        PRINTF("DEBUG: Performing fusion on the queue. Current queue length=%d\n", bcp_queue_length(q));
         
         /*
-         * The complexity of this function is O(N^(NUM_CID)) 
-         *
+         * The queue keeps the fusable packets of every CID in their own group, 
+         * so only these packets are visited.
          */
         
         for(i = 1; i < NUM_CID+1; i++){ //CID loop     
             eCID = i;
-            fusionItemCounter = perFusion = fusionDelay = 0;
-            eNested = top;
+            fusionItemCounter = fusionDelay = 0;
             
-            for(j=0; j < len; j++){
-               
-                if(j!=0) //If it is not top, get the next packet in the queue
-                    eNested =  bcp_queue_next(q, eNested);
-              
-                if(eNested == NULL || get_fusion_budget() == 0)
-                    break;
-                 //printf("j=%d CID=%d\n", j, eCID);
-                // printf("node[%d] p=%p fused=%d\n", eNested->hdr.bcp_header.origin.u8[0], eNested,  eNested->hdr.fused);
-                   
-                if(eNested->hdr.CID == eCID && eNested->hdr.fused == 0){ 
-                     
-                    //Version 1 - if I am not the source, fused me 
-                    if(rimeaddr_cmp(&eNested->hdr.bcp_header.origin, &rimeaddr_node_addr))
-                        continue;
-                    
-                    if(isFusionPacket(eNested)){
-                        uint16_t f = 0;
-                        memcpy(&f, &eNested->data, 2);
-                        perFusion += f; 
-                    }
-                    
+            //Fusion needs at least two packets of the group
+            if(bcp_queue_group_length(q, eCID) < 2)
+                continue;
+            
+            for(eNested = (struct fusion_queue_item *) bcp_queue_group_top(q, eCID); 
+                    eNested != NULL && get_fusion_budget(c) != 0; 
+                    eNested = (struct fusion_queue_item *) bcp_queue_group_next(q, (struct bcp_queue_item *) eNested)){
                 
-                    
-                    //If all required conditions passed, add queue item to the fusion list;
-                    fusionList[fusionItemCounter] = eNested;
-                    fusionDelay += eNested->hdr.bcp_header.delay;
-                    fusionItemCounter++;
-                    
-                    if(fusionItemCounter > 2)
-                       set_consumed_fusion_budget(1);
-                    else if(fusionItemCounter == 2)
-                       set_consumed_fusion_budget(2); //To avoid fusion where only one packet exists 
-               } //if same CID   
-            } //j loop
+                //Add queue item to the fusion list;
+                fusionDelay += eNested->hdr.bcp_header.delay;
+                fusionItemCounter++;
+                
+                if(fusionItemCounter > 2)
+                   set_consumed_fusion_budget(c, 1);
+                else if(fusionItemCounter == 2)
+                   set_consumed_fusion_budget(c, 2); //To avoid fusion where only one packet exists 
+            } //group loop
            
-            //Execute the fusion rule on the fusion list
-            short result = fusionRule(fusionList, fusionItemCounter);
-             
             if(fusionItemCounter > 1){
+                //Execute the fusion rule on the fusion list
+                fusionRule(q, eCID, fusionItemCounter, &result);
+
                 printf("fused=%d\n", fusionItemCounter);
                 //Remove the packets after the fusion 
-                removeFusedPackets(q,&fusionList, fusionItemCounter);
-                //Add the fusion packet to the list 
-                struct fusion_queue_item fusionPacket;
-                fusionPacket.hdr.fused = 1;
-                fusionPacket.hdr.CID = eCID;
-                fusionPacket.hdr.bcp_header.packet_length = sizeof(struct fusion_queue_item);
-                fusionPacket.hdr.bcp_header.origin.u8[0] = 250;
-                fusionPacket.hdr.bcp_header.origin.u8[1] = 250;
-                fusionPacket.hdr.bcp_header.delay = fusionDelay/fusionItemCounter; //Average delay
-                fusionPacket.hdr.bcp_header.lastProcessTime = clock_time();
-                uint16_t totalFusion =  perFusion + fusionItemCounter; //The data is actual the number of packets fused in this fusion packet
-                memcpy(&fusionPacket.data, &totalFusion,2 );
-                
-                
-                bcp_queue_push(q, &fusionPacket);
+                removeFusedPackets(q, eCID, fusionItemCounter);
+                //Add the fusion packet to the list, written straight into its queue record 
+                struct fusion_queue_item * fusionPacket = (struct fusion_queue_item *) bcp_queue_reserve(q);
+                if(fusionPacket != NULL){
+                    setFusionOrigin(c, fusionPacket);
+                    fusionPacket->hdr.CID = eCID;
+                    fusionPacket->hdr.bcp_header.packet_length = sizeof(struct fusion_queue_item);
+                    fusionPacket->hdr.bcp_header.delay = fusionDelay/fusionItemCounter; //Average delay
+                    fusionPacket->hdr.bcp_header.lastProcessTime = clock_time();
+                    //The data is the number of readings fused in this fusion packet and their merged value
+                    fusion_state_write(eCID, &result, fusionPacket->data);
+                    
+                    bcp_queue_commit(q, (struct bcp_queue_item *) fusionPacket);
+                }
                 //PRINTF("DEBUG: Fusion packet was added to the queue \n");
           }
    } //i loop
-          PRINTF("DEBUG: Fusion has been done i=%d j=%d \n", i, j);
+          PRINTF("DEBUG: Fusion has been done i=%d \n", i);
  }
 
 
 
+/**
+ * Merges a packet arriving in the queue into the first queued packet of its 
+ * group, in place, if the fusion budget allows it (FUSION_ON_ARRIVAL). The 
+ * queued packet becomes a fusion packet of this node and leaves its group.
+ */
+struct bcp_queue_item* mergeOnArrival(struct bcp_conn *c, struct bcp_queue_item* itm){
+#if FUSION_ON_ARRIVAL
+    struct fusion_queue_item * fItm = (struct fusion_queue_item *) itm;
+    struct fusion_queue_item * target;
+    struct fusion_state s, other;
+    clock_time_t now = clock_time();
+    uint8_t eCID = fusionGroup(itm);
+    
+    if(c->isSink || eCID == BCP_QUEUE_NO_GROUP)
+        return NULL;
+    target = (struct fusion_queue_item *) bcp_queue_group_top(&c->packet_queue, eCID);
+    if(target == NULL)
+        return NULL;
+    //Two packets cost as much as in performFusion()
+    if(get_fusion_budget(c) < 2)
+        return NULL;
+    set_consumed_fusion_budget(c, 2);
+    
+    fusion_state_read(eCID, target->data, isFusionPacket((struct bcp_queue_item *) target), &s);
+    fusion_state_read(eCID, fItm->data, isFusionPacket(itm), &other);
+    
+    //The delay is the average of the readings, both taken up to now
+    target->hdr.bcp_header.delay += now - target->hdr.bcp_header.lastProcessTime;
+    target->hdr.bcp_header.lastProcessTime = now;
+    //Summed in 32 bits, the products overflow a 16 bit clock_time_t
+    target->hdr.bcp_header.delay = ((uint32_t) target->hdr.bcp_header.delay * s.count 
+            + (uint32_t) fItm->hdr.bcp_header.delay * other.count) / (s.count + other.count);
+    
+    fusion_state_merge(eCID, &s, &other);
+    fusion_state_write(eCID, &s, target->data);
+    //A copy of the packet before the merge is another packet
+    setFusionOrigin(c, target);
+    //Fused here, it leaves its group like the fusion packets of performFusion()
+    bcp_queue_group_remove(&c->packet_queue, (struct bcp_queue_item *) target);
+    PRINTF("DEBUG: A packet has been merged on arrival, %d readings of CID %d\n", s.count, eCID);
+    
+    return (struct bcp_queue_item *) target;
+#else
+    return NULL;
+#endif
+}
+
 void onReceiving(struct bcp_conn *c, struct bcp_queue_item* itm){
     PRINTF("DEBUG: On Receiving Data \n");
    
@@ -272,13 +334,47 @@ void prepareDataPacket(struct bcp_conn *c,  struct bcp_queue_item* itm){
 }
 
 
-static const struct bcp_extender ex = {&prepareDataPacket, &beforeSending, &afterSending, &onReceiving, &onUserRequest};
+/**
+ * \return the fusion fields sent with a packet: the fusion packet flag in bit 0 
+ * and the CID above it. The fused flag only holds in the node which fused the 
+ * packet and is not sent.
+ */
+uint8_t encodeWire(struct bcp_conn *c, struct bcp_queue_item* itm){
+    struct fusion_queue_item * fItm = ( struct fusion_queue_item *) itm;
+    
+    return (fItm->hdr.bcp_header.merged != 0) | (fItm->hdr.CID << 1);
+}
+
+void decodeWire(struct bcp_conn *c, struct bcp_queue_item* itm, uint8_t ext){
+    struct fusion_queue_item * fItm = ( struct fusion_queue_item *) itm;
+    
+    fItm->hdr.bcp_header.merged = ext & 1;
+    fItm->hdr.fused = 0;
+    fItm->hdr.CID = ext >> 1;
+    fItm->hdr.bcp_header.packet_length = sizeof(struct fusion_queue_item);
+}
+
+
+/**
+ * Describes a packet delivered at the sink: a fusion packet stands for the 
+ * number of packets fused into it, which starts its data.
+ */
+void describeData(struct bcp_conn *c, struct bcp_queue_item* itm, uint16_t *count, uint8_t *group){
+    struct fusion_queue_item * fItm = ( struct fusion_queue_item *) itm;
+    
+    if(isFusionPacket(itm))
+        memcpy(count, &fItm->data, 2);
+    *group = fItm->hdr.CID;
+}
+
+
+static const struct bcp_extender ex = {&prepareDataPacket, &beforeSending, &afterSending, &onReceiving, &onUserRequest, &encodeWire, &decodeWire, &describeData, &mergeOnArrival};
 
 
 void bcp_queue_allocator_init(struct bcp_conn *c){
  
-    c->packet_queue.memb = &fusion_packet_queue_memb;
-    memb_init(&fusion_packet_queue_memb);    
+    c->packet_queue.memb = fusion_packet_queue_memb_init(c);    
+    bcp_queue_group_init(&c->packet_queue, &fusionGroup); //One group per CID
     c->ce = &ex; //Set the custom BCP extender  
 }
 
@@ -19,7 +19,27 @@
 #define E_SEND_MIN 5
 #define E_SEND_MAX 15
 
-#define NUM_PARENTS 1
+//Number of parents of a node in the DAG routing table (bcp_routing_table_dag.c)
+#ifndef NUM_PARENTS
+#define NUM_PARENTS 3
+#endif
+
+//Number of correlation groups (CID), every node belongs to one of them
+#ifndef NUM_CID
+#define NUM_CID 2
+#endif
+
+//Fusion operator of every CID from CID 1, see fusion_operator.h
+#ifndef FUSION_OPERATORS
+#define FUSION_OPERATORS { &fusion_max, &fusion_mean }
+#endif
+
+//Merges a packet into a queued packet of its CID when it arrives, whenever 
+//the energy budget allows it, rather than only at the beginning of the time
+//slots spent fusing (see fusion.c)
+#ifndef FUSION_ON_ARRIVAL
+#define FUSION_ON_ARRIVAL 0
+#endif
 
 #endif	/* FUSION_CONFIG_H */
 
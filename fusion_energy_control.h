@@ -7,11 +7,14 @@
 #ifndef FUSION_ENERGY_CONTROL_H
 #define	FUSION_ENERGY_CONTROL_H
 
-unsigned short get_sending_budget();
-unsigned short get_fusion_budget();
+struct bcp_conn;
 
-void set_consumed_sending_budget(unsigned short b);
-void set_consumed_fusion_budget(unsigned short b);
+//The budgets are those of the given connection
+unsigned short get_sending_budget(struct bcp_conn *c);
+unsigned short get_fusion_budget(struct bcp_conn *c);
+
+void set_consumed_sending_budget(struct bcp_conn *c, unsigned short b);
+void set_consumed_fusion_budget(struct bcp_conn *c, unsigned short b);
 
 #endif	/* FUSION_ENERGY_CONTROL_H */
 
@@ -0,0 +1,110 @@
+#include "fusion_operator.h"
+#include "bcp-config.h"
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#if MAX_USER_PACKET_SIZE < FUSION_STATE_SIZE
+#error "MAX_USER_PACKET_SIZE cannot hold the merge state of a fusion packet"
+#endif
+
+static uint32_t merge_min(uint32_t a, uint32_t b){
+    return a < b ? a : b;
+}
+
+static uint32_t merge_max(uint32_t a, uint32_t b){
+    return a > b ? a : b;
+}
+
+static uint32_t merge_sum(uint32_t a, uint32_t b){
+    return a + b;
+}
+
+static uint32_t merge_or(uint32_t a, uint32_t b){
+    return a | b;
+}
+
+static uint32_t result_count(const struct fusion_state *s){
+    return s->count;
+}
+
+static uint32_t result_mean(const struct fusion_state *s){
+    return s->count != 0 ? s->value / s->count : 0;
+}
+
+const struct fusion_operator fusion_min = {2, merge_min, NULL};
+const struct fusion_operator fusion_max = {2, merge_max, NULL};
+const struct fusion_operator fusion_sum = {4, merge_sum, NULL};
+const struct fusion_operator fusion_count = {0, NULL, result_count};
+const struct fusion_operator fusion_mean = {4, merge_sum, result_mean};
+const struct fusion_operator fusion_or = {2, merge_or, NULL};
+
+//The operator of every CID, from CID 1
+static const struct fusion_operator * operators[NUM_CID] = FUSION_OPERATORS;
+
+bool fusion_operator_set(uint16_t cid, const struct fusion_operator *op){
+    if(cid < 1 || cid > NUM_CID || op == NULL)
+        return false;
+
+    PRINTF("DEBUG: CID %d uses a new fusion operator\n", cid);
+    operators[cid - 1] = op;
+    return true;
+}
+
+const struct fusion_operator * fusion_operator_get(uint16_t cid){
+    if(cid < 1 || cid > NUM_CID)
+        return NULL;
+    return operators[cid - 1];
+}
+
+void fusion_state_read(uint16_t cid, const char *data, bool fused, struct fusion_state *s){
+    const struct fusion_operator *op = fusion_operator_get(cid);
+    const uint8_t *p = (const uint8_t *) data + 2;
+    uint16_t reading;
+    uint8_t k;
+
+    if(!fused){
+        memcpy(&reading, data, 2);
+        s->count = 1;
+        s->value = reading;
+        return;
+    }
+
+    memcpy(&s->count, data, 2);
+    s->value = 0;
+    for(k = 0; op != NULL && k < op->size; k++)
+        s->value |= (uint32_t) p[k] << (8 * k);
+}
+
+void fusion_state_merge(uint16_t cid, struct fusion_state *s, const struct fusion_state *other){
+    const struct fusion_operator *op = fusion_operator_get(cid);
+
+    if(op != NULL && op->merge != NULL)
+        s->value = op->merge(s->value, other->value);
+    s->count += other->count;
+}
+
+void fusion_state_write(uint16_t cid, const struct fusion_state *s, char *data){
+    const struct fusion_operator *op = fusion_operator_get(cid);
+    uint8_t *p = (uint8_t *) data + 2;
+    uint8_t k;
+
+    memset(data, 0, MAX_USER_PACKET_SIZE);
+    memcpy(data, &s->count, 2);
+    for(k = 0; op != NULL && k < op->size; k++)
+        p[k] = s->value >> (8 * k);
+}
+
+uint32_t fusion_state_result(uint16_t cid, const struct fusion_state *s){
+    const struct fusion_operator *op = fusion_operator_get(cid);
+
+    if(op != NULL && op->result != NULL)
+        return op->result(s);
+    return s->value;
+}
@@ -0,0 +1,96 @@
+/**
+ * \file
+ *         Fusion operators: how the packets of a correlation group (CID) are
+ *         merged into one fusion packet.
+ *
+ *         Every packet stands for a merge state: the number of readings it
+ *         carries and their merged value. A packet from a sensor is one
+ *         reading, its data starting with the reading (uint16_t). The data of
+ *         a fusion packet is
+ *           count    u16   number of readings, in the byte order of the nodes
+ *           value    u8[size of the operator], little endian
+ *         so the operators only differ in the way values are merged and in
+ *         the size of the value:
+ *           min, max   smallest or largest reading            2 bytes
+ *           sum        sum of the readings                    4 bytes
+ *           count      number of readings only                0 bytes
+ *           mean       sum of the readings, divided by count  4 bytes
+ *           or         bitwise OR of event flags              2 bytes
+ *
+ *         The operator of every CID is chosen at compile time with
+ *         FUSION_OPERATORS (see fusion_config.h) and may be changed at run
+ *         time with fusion_operator_set(). All the nodes must use the same
+ *         operator for a CID, since they merge the states of each other.
+ */
+
+#ifndef FUSION_OPERATOR_H
+#define	FUSION_OPERATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fusion_config.h"
+
+//Largest merge state in the data of a fusion packet: the count and a 4 bytes value
+#define FUSION_STATE_SIZE 6
+
+/**
+ * \brief      The readings carried by a packet
+ */
+struct fusion_state {
+  uint16_t count;
+  uint32_t value;
+};
+
+/**
+ * \brief      A fusion operator
+ */
+struct fusion_operator {
+  //Bytes the merged value takes in the data of a fusion packet
+  uint8_t size;
+  //Merges two values, NULL if the operator only counts the readings
+  uint32_t (* merge)(uint32_t a, uint32_t b);
+  //The result of a merge state, NULL if it is the value itself
+  uint32_t (* result)(const struct fusion_state *s);
+};
+
+extern const struct fusion_operator fusion_min;
+extern const struct fusion_operator fusion_max;
+extern const struct fusion_operator fusion_sum;
+extern const struct fusion_operator fusion_count;
+extern const struct fusion_operator fusion_mean;
+extern const struct fusion_operator fusion_or;
+
+/**
+ * \breif Sets the operator of the given CID (1 to NUM_CID)
+ * \return false if there is no such CID
+ */
+bool fusion_operator_set(uint16_t cid, const struct fusion_operator *op);
+
+/**
+ * \return the operator of the given CID, NULL if there is no such CID
+ */
+const struct fusion_operator * fusion_operator_get(uint16_t cid);
+
+/**
+ * \breif Reads the merge state of a packet of the given CID from its data
+ * \param fused true for a fusion packet, false for a single reading
+ */
+void fusion_state_read(uint16_t cid, const char *data, bool fused, struct fusion_state *s);
+
+/**
+ * \breif Merges the state other into s, both of the given CID
+ */
+void fusion_state_merge(uint16_t cid, struct fusion_state *s, const struct fusion_state *other);
+
+/**
+ * \breif Writes a merge state of the given CID to the data of a fusion packet
+ */
+void fusion_state_write(uint16_t cid, const struct fusion_state *s, char *data);
+
+/**
+ * \return the result of a merge state of the given CID, e.g. the mean of the
+ * readings for fusion_mean
+ */
+uint32_t fusion_state_result(uint16_t cid, const struct fusion_state *s);
+
+#endif	/* FUSION_OPERATOR_H */
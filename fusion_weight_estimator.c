@@ -24,6 +24,8 @@
 #include "lib/random.h"
 #include "fusion.h"
 #include "lpm.h"
+#include "sensing_control.h"
+#include <stdio.h>
 
 #define DEBUG 0
 #if DEBUG
@@ -39,20 +41,7 @@
 
 
 
-static unsigned short fusing_cost;
-static unsigned short sensing_cost;
-static unsigned short sending_cost;
-static unsigned short energy_budget;
-
-static struct routingtable_item_bcp * bestNeighbor;
-static int bestWeight;
-static bool timerInit;
-static bool should_send;
-static unsigned short consumed_fusion_packet = 0;
-static unsigned short consumed_transfer_packet = 0;
-
 static clock_time_t t_slot_duration = CLOCK_SECOND * SLOT_DURATION;
-static struct ctimer time_slot_timer; 
 
 /**
  * \brief      A structure add custom weight estimator metrics to routingtable item 
@@ -62,10 +51,31 @@ struct routingtable_item_bcp {
   struct routingtable_item item;
 };
 
+/**
+ * \brief      The energy budgets and the best neighbor of a BCP connection
+ */
+struct fusion_estimator {
+  unsigned short fusing_cost;
+  unsigned short sensing_cost;
+  unsigned short sending_cost;
+  unsigned short energy_budget;
+
+  struct routingtable_item_bcp * bestNeighbor;
+  int bestWeight;
+  bool timerInit;
+  bool should_send;
+  unsigned short consumed_fusion_packet;
+  unsigned short consumed_transfer_packet;
+
+  struct ctimer time_slot_timer; 
+};
+
+//The estimator of every opened connection, see bcp_conn.index
+static struct fusion_estimator estimators[BCP_MAX_CONNECTIONS];
 
 //Memory allocation for the routing table. This is defined here because 
 //weight estimators may require to add extra columns to the routingtable_item 
-MEMB(routing_table_memb, struct routingtable_item_bcp, MAX_ROUTING_TABLE_SIZE);
+BCP_MEMB(routing_table_memb, struct routingtable_item_bcp, MAX_ROUTING_TABLE_SIZE);
 
 
 
@@ -74,9 +84,9 @@ void newTimeSlot(struct bcp_conn *c);
 /**
  * \return True if the node can send data in this duty cycle. Othersiwse, false.
  */
-static bool canSend(){
+static bool canSend(struct bcp_conn *c){
     //Calculate 
-    return should_send;
+    return estimators[c->index].should_send;
 }
 
 
@@ -84,26 +94,35 @@ static bool canSend(){
 /**
  * \return True if the node can fusion data in this duty cycle. Othersiwse, false.
  */
-static bool canFusion(){
-    //Calculate 
-    return !canSend();
+static bool canFusion(struct bcp_conn *c){
+    //Packets merged on arrival save their sending in any time slot
+    return FUSION_ON_ARRIVAL || !canSend(c);
+}
+
+/**
+ * \breif Calls newTimeSlot() for the time slot timer, whose callbacks take a void pointer
+ */
+static void newTimeSlot_cb(void *c){
+    newTimeSlot((struct bcp_conn *) c);
 }
 
 static void resetTimer(struct bcp_conn *c){
-    if(ctimer_expired(&time_slot_timer)) {
-      ctimer_set(&time_slot_timer, t_slot_duration, newTimeSlot, c);
+    struct ctimer *t = &estimators[c->index].time_slot_timer;
+    if(ctimer_expired(t)) {
+      ctimer_set(t, t_slot_duration, newTimeSlot_cb, c);
     }
 }
 
 /**
  * \return the number of packets can be fused in the current time cycle.
  */
-unsigned short get_fusion_budget(){
+unsigned short get_fusion_budget(struct bcp_conn *c){
+    struct fusion_estimator *e = &estimators[c->index];
     
-    if(!canFusion())
+    if(!canFusion(c))
         return 0;
     
-    unsigned short result = (energy_budget/fusing_cost);
+    unsigned short result = (e->energy_budget/e->fusing_cost);
  //   PRINTF("DEBUG: Fusion Budget = %d \n", result);
     return (unsigned short)result; 
 }
@@ -112,41 +131,56 @@ unsigned short get_fusion_budget(){
 /**
  * \return the number of packets can be transfered in the current time cycle.
  */
-unsigned short get_sending_budget(){
+unsigned short get_sending_budget(struct bcp_conn *c){
+    struct fusion_estimator *e = &estimators[c->index];
     
-    if(!canSend())
+    if(!canSend(c))
         return 0;
 
-    unsigned short result = (energy_budget/sending_cost);
+    unsigned short result = (e->energy_budget/e->sending_cost);
     //PRINTF("DEBUG: Sending Budget = %d \n", result);
     return (unsigned short)result; 
 }
 
-void set_consumed_sending_budget(unsigned short b){
-    if(energy_budget - b*sending_cost < 0)
-        energy_budget = 0;
+void set_consumed_sending_budget(struct bcp_conn *c, unsigned short b){
+    struct fusion_estimator *e = &estimators[c->index];
+    if(e->energy_budget - b*e->sending_cost < 0)
+        e->energy_budget = 0;
     else
-        energy_budget -= (b*sending_cost);
+        e->energy_budget -= (b*e->sending_cost);
     //printf("consumed sending budget, energy_budget=%d\n",energy_budget);
 }
 
-void set_consumed_fusion_budget(unsigned short b){
-    if(energy_budget - b*fusing_cost < 0)
-        energy_budget = 0;
+void set_consumed_fusion_budget(struct bcp_conn *c, unsigned short b){
+    struct fusion_estimator *e = &estimators[c->index];
+    if(e->energy_budget - b*e->fusing_cost < 0)
+        e->energy_budget = 0;
     else
-        energy_budget -= (b*fusing_cost); 
+        e->energy_budget -= (b*e->fusing_cost); 
     //printf("consumed fusion budget, energy_budget=%d\n",energy_budget);
 }
 
-static void calcSendingCost(){
+static void calcSendingCost(struct fusion_estimator *e){
     //Calculate the energy cost of one transfer
-    sending_cost = E_SEND_MIN;
-    sending_cost += random_rand() % (E_SEND_MAX - E_SEND_MIN);
-    if(sending_cost==0)
-        sending_cost = 1;
+    e->sending_cost = E_SEND_MIN;
+    e->sending_cost += random_rand() % (E_SEND_MAX - E_SEND_MIN);
+    if(e->sending_cost==0)
+        e->sending_cost = 1;
+}
+
+/**
+ * \return the queue differential with the given neighbor, less WEIGHT_HOP_V 
+ * for every hop the neighbor is away from a shortest path to the sink
+ */
+static int backlogWeight(struct bcp_conn *c, struct routingtable_item_bcp * i){
+    int w = (int) bcp_queue_length(&c->packet_queue);
+    w -= i->item.backpressure;
+    w -= WEIGHT_HOP_V * (int) hop_counter_gradient(c, i->item.hop_count);
+    return w;
 }
 
 static void performSensing(struct bcp_conn *c){
+    struct fusion_estimator *e = &estimators[c->index];
     //Perform sensing before anything
     uint16_t rx = sensing_rate(&(c->packet_queue));
     printf("Rx=%d\n", rx);
@@ -158,10 +192,10 @@ static void performSensing(struct bcp_conn *c){
          packetbuf_copyfrom(&d, 2);
          bcp_send(c);
          
-         if(energy_budget-sensing_cost < 1)
+         if(e->energy_budget-e->sensing_cost < 1)
              break;
          //Update consumed energy
-         energy_budget -= sensing_cost;
+         e->energy_budget -= e->sensing_cost;
     }
 }
 
@@ -171,86 +205,88 @@ static void performSensing(struct bcp_conn *c){
    * and save it. 
    */
 void newTimeSlot(struct bcp_conn *c){
+    struct fusion_estimator *e = &estimators[c->index];
    
     if(c->isOpen == false)
         return;
     
-    timerInit = true;
+    e->timerInit = true;
     PRINTF("DEBUG: Routing table length=%d\n", routingtable_length(&c->routing_table) );
    
     PRINTF("DEBUG: Fusion weight estimator Time slot timer has been triggered \n");
     PRINTF("rimeaddr_node_addr[%d].[%d]\n", rimeaddr_node_addr.u8[0], rimeaddr_node_addr.u8[1]);
     
-    lpm_set_unusedEnergy(energy_budget);
+    lpm_set_unusedEnergy(e->energy_budget);
     
-    printf("ACK=%d\n", returnACK());
-    resetACK();
+    printf("ACK=%d\n", returnACK(c));
+    resetACK(c);
     //ASK for solar data
     printf("solar?\n"); //This is required because the data is passed by serial port
-    energy_budget = lpm_get_energy_budget();
-    //energy_budget = 0;
-    calcSendingCost();
+    e->energy_budget = lpm_get_energy_budget();
+    //e->energy_budget = 0;
+    calcSendingCost(e);
     
-    if(energy_budget > 1 && !c->isSink){ //LPM is not initialized yet
+    if(e->energy_budget > 1 && !c->isSink){ //LPM is not initialized yet
         int len = bcp_queue_length(&c->packet_queue);
         //printf("len=%d \n", len);
 
-        //Find the best neighbor from the routing table.
+        //Find the best neighbor from the routing table. Every neighbor 
+        //is weighed since the weights are computed differently now
+        routingtable_invalidate(&c->routing_table);
         rimeaddr_t* neighborAddr = routingtable_find_routing(&c->routing_table);
         //If there is a neighbor
         if(neighborAddr != NULL){
-            bestNeighbor = (struct routingtable_item_bcp *) routing_table_find(&c->routing_table, neighborAddr);
+            e->bestNeighbor = (struct routingtable_item_bcp *) routing_table_find(&c->routing_table, neighborAddr);
 
             PRINTF("DEBUG: Best neighbor for this time slot is node[%d].[%d] \n", 
-                        bestNeighbor->item.neighbor.u8[0],
-                        bestNeighbor->item.neighbor.u8[1]);
+                        e->bestNeighbor->item.neighbor.u8[0],
+                        e->bestNeighbor->item.neighbor.u8[1]);
 
             //Calculate the weight for the best neighbor
             int len = (int) bcp_queue_length(&c->packet_queue);
             PRINTF("DEBUG: Queue length for this time slot=%d \n", len);
-            int w = len;
-            w -= bestNeighbor->item.backpressure;
+            int w = backlogWeight(c, e->bestNeighbor);
 
-            bestWeight = w; 
-            PRINTF("DEBUG: Best weight for this time slot=%d \n", bestWeight);
+            e->bestWeight = w; 
+            PRINTF("DEBUG: Best weight for this time slot=%d \n", e->bestWeight);
 
-            w /= sending_cost; 
+            w /= e->sending_cost; 
 
             int f =  len;
-            f /= fusing_cost;
+            f /= e->fusing_cost;
             PRINTF("DEBUG: w=%d and f=%d \n", w, f);
             int bigerLine = 0;
             if(f <= w){
-                should_send = true;
+                e->should_send = true;
                 //printf("send mode\n");
                 bigerLine = w;
             }else{
-                should_send = false;
+                e->should_send = false;
                 bigerLine = f;
             }
-            PRINTF("DEBUG: should_send=%d \n", should_send);
+            PRINTF("DEBUG: should_send=%d \n", e->should_send);
             
             //Set sensing paramters
             sensing_setBigerLine(bigerLine);
             //PRINTF("SENSING_COST=%d\n", sensing_cost);
-            sensing_setCost(sensing_cost);
+            sensing_setCost(e->sensing_cost);
             
             performSensing(c);
-            PRINTF("DEBUG: Energy left after sensing=%d\n", energy_budget);
+            PRINTF("DEBUG: Energy left after sensing=%d\n", e->energy_budget);
             
-            consumed_transfer_packet = 0;
-            consumed_fusion_packet = 0;
+            e->consumed_transfer_packet = 0;
+            e->consumed_fusion_packet = 0;
             //If not send directly
-            if(should_send == false && c->isSink == 0){
+            if(e->should_send == false && c->isSink == 0){
                performFusion(&c->packet_queue);
             }
             
-            PRINTF("DEBUG: Energy left after fusion=%d\n", energy_budget);
+            PRINTF("DEBUG: Energy left after fusion=%d\n", e->energy_budget);
             
             //In case of energy left
-            if(energy_budget != 0){
-                should_send = true;
-                PRINTF("DEBUG: Energy budget left (%d) switch to the sending mode\n",energy_budget);
+            if(e->energy_budget != 0){
+                e->should_send = true;
+                PRINTF("DEBUG: Energy budget left (%d) switch to the sending mode\n",e->energy_budget);
             }
             
 
@@ -258,25 +294,29 @@ void newTimeSlot(struct bcp_conn *c){
             PRINTF("ERROR: No neighbor for fusion weight estimator to calculate the energy budgets \n");
             //Just performing sensing
             sensing_setBigerLine(1);
-            sensing_setCost(sensing_cost);
+            sensing_setCost(e->sensing_cost);
             performSensing(c);
             
-            energy_budget = 0;
+            e->energy_budget = 0;
         }
    }
     
     if(c->isSink){
-        energy_budget = 0;
+        e->energy_budget = 0;
     }
     //Reset the parameters 
-    consumed_transfer_packet = 0;
-    consumed_fusion_packet = 0;
+    e->consumed_transfer_packet = 0;
+    e->consumed_fusion_packet = 0;
 
+    //BCP may send again with the new budget
+    bcp_wakeup(c);
     
     //Reset the timer
     resetTimer(c);
     
-    timerInit = false;   
+    e->timerInit = false;   
+    //Back to the weights of the best neighbor chosen for this time slot
+    routingtable_invalidate(&c->routing_table);
 }
 
 /*********************************BCP PUBLIC FUNCTION**************************/
@@ -284,8 +324,10 @@ int weight_estimator_getWeight(struct bcp_conn *c, struct routingtable_item * it
     
   
     
+    struct fusion_estimator *e = &estimators[c->index];
+    
     //If it is called by time slot timer
-    if(timerInit == true){
+    if(e->timerInit == true){
         
         //Then calc the weight normally
         struct routingtable_item_bcp * i = (struct routingtable_item_bcp *) it;
@@ -293,8 +335,7 @@ int weight_estimator_getWeight(struct bcp_conn *c, struct routingtable_item * it
 
         
         //Calculate the weight 
-        w = (int) bcp_queue_length(&c->packet_queue);
-        w -= i->item.backpressure;
+        w = backlogWeight(c, i);
         PRINTF("neight_q_log=%d node[%d].[%d] w=%d\n", 
                 i->item.backpressure, 
                 i->item.neighbor.u8[0],
@@ -305,8 +346,8 @@ int weight_estimator_getWeight(struct bcp_conn *c, struct routingtable_item * it
     }else{
         //If it is called by the routing table, then only to send the best neighbor 
         //which is calculated at the beginning each time cycle.
-        if(it == bestNeighbor){
-            return bestWeight;
+        if(it == (struct routingtable_item *) e->bestNeighbor){
+            return e->bestWeight;
         }else{
             return 1;
         }
@@ -315,34 +356,40 @@ int weight_estimator_getWeight(struct bcp_conn *c, struct routingtable_item * it
 
 void weight_estimator_sent(struct routingtable_item * it, 
                                 struct bcp_queue_item *qi, 
-                                uint16_t attempts){
+                                uint16_t attempts,
+                                clock_time_t tx_time){
 }
 
 void weight_estimator_init(struct bcp_conn *c){
+    struct fusion_estimator *e = &estimators[c->index];
+    
     PRINTF("DEBUG: Fusion weight_estimator_init has been called \n");
-    c->routing_table.memb = &routing_table_memb;
-    memb_init(&routing_table_memb);
+    c->routing_table.memb = routing_table_memb_init(c);
+    
+    //Nothing is left of a connection which used the same slot before
+    ctimer_stop(&e->time_slot_timer);
+    memset(e, 0, sizeof(struct fusion_estimator));
     
     //Calculate The energy cost of one fuse packet
-    fusing_cost = E_FUSE_MIN;
-    fusing_cost += random_rand() % (E_FUSE_MAX - E_FUSE_MIN);
+    e->fusing_cost = E_FUSE_MIN;
+    e->fusing_cost += random_rand() % (E_FUSE_MAX - E_FUSE_MIN);
     
-    if(fusing_cost==0)
-        fusing_cost = 1;
+    if(e->fusing_cost==0)
+        e->fusing_cost = 1;
     //Calculate the energy cost of one transfer
-    calcSendingCost();
+    calcSendingCost(e);
     
     //Calculate the energy cost for one sensing 
-    sensing_cost = E_SENSING_MIN;
-    sensing_cost += random_rand() % (E_SENSING_MAX - E_SENSING_MIN);
-    if(sensing_cost==0)
-        sensing_cost = 1;
+    e->sensing_cost = E_SENSING_MIN;
+    e->sensing_cost += random_rand() % (E_SENSING_MAX - E_SENSING_MIN);
+    if(e->sensing_cost==0)
+        e->sensing_cost = 1;
     
     
     PRINTF("DEBUG: For this node: fusing_cost=%d, sending_cost=%d, and sensing_cost=%d \n", 
-                fusing_cost,
-                sending_cost,
-                sensing_cost);
+                e->fusing_cost,
+                e->sending_cost,
+                e->sensing_cost);
     
     PRINTF("DEBUG: Routing table length=%d\n", routingtable_length(&c->routing_table) );
    
@@ -354,7 +401,17 @@ void weight_estimator_record_init(struct routingtable_item * it){
     
 }
 
+void weight_estimator_record_free(struct bcp_conn *c, struct routingtable_item * it){
+    struct fusion_estimator *e = &estimators[c->index];
+    
+    //The best neighbor is chosen again at the next time slot
+    if(it == (struct routingtable_item *) e->bestNeighbor){
+        e->bestNeighbor = NULL;
+        e->bestWeight = 0;
+        routingtable_invalidate(&c->routing_table);
+    }
+}
+
 void weight_estimator_print_item(struct bcp_conn *c, struct routingtable_item *item){
-    struct routingtable_item_bcp * i = item; 
     PRINTF("weight: %d\n", weight_estimator_getWeight(c, item));
 }
\ No newline at end of file
@@ -1,9 +1,6 @@
 #include "hop_counter.h"
 #include "bcp.h"
 #include "net/rime.h"
-#include "net/rime/unicast.h"
-#include "net/rime/broadcast.h"
-#include "lib/random.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -14,126 +11,63 @@
 #endif
 
 
-struct hop_counter_msg {
-  uint16_t hop_count; 
-};
-
-struct broadcast_conn hc_broadcast_conn;
-static uint16_t hc_channel = 22; //Temp channel
-static clock_time_t prepare_time = CLOCK_SECOND * 1;
-static short maxSeconds = 10;
-static clock_time_t hc_time;
-static struct ctimer hc_timer;
-static struct bcp_conn * current_bcp;
-static bool isInitialized = false;
-
-
-static void sent_from_broadcast(struct broadcast_conn *c, int status,
-                                int transmissions);
-static void recv_from_broadcast(struct broadcast_conn *c,
-                                const rimeaddr_t *from);
-static void send_packet(void *ptr);
-static void close_phase(void *ptr);
-
-static const struct broadcast_callbacks hc_broadcast_callbacks = {
-    recv_from_broadcast,
-    sent_from_broadcast };
-
-static void sent_from_broadcast(struct broadcast_conn *c, int status,
-                                int transmissions)
-{
-    isInitialized = true;
-    hc_time = (CLOCK_SECOND * maxSeconds);
-    ctimer_set(&hc_timer, hc_time, close_phase,current_bcp);
+bool hop_counter_update(void *c){
+    struct bcp_conn *bcp_c = (struct bcp_conn *) c;
+    struct routingtable_item * shortestPath;
+    uint16_t hop_count = 0;
+    
+    if(bcp_c->isSink){
+        hop_count = 1; //Because zero means hop-count is not initialized yet
+    }else{
+        shortestPath = routing_table_find_shortestPath(&bcp_c->routing_table);
+        //Routes of HOP_COUNT_MAX hops or more are taken as a count to infinity
+        //(e.g. two neighbors leading to each other after losing their parent)
+        if(shortestPath != NULL && shortestPath->hop_count + 1 < HOP_COUNT_MAX)
+            hop_count = shortestPath->hop_count + 1;
+    }
+    
+    if(hop_count == bcp_c->hop_counter.hop_count)
+        return false;
+    
+    PRINTF("DEBUG: The hop count changed from %d to %d\n", 
+            bcp_c->hop_counter.hop_count, hop_count);
+    bcp_c->hop_counter.hop_count = hop_count;
+    //The weights of the neighbors depend on it (see hop_counter_gradient())
+    routingtable_invalidate(&bcp_c->routing_table);
+    return true;
 }
 
-static void recv_from_broadcast(struct broadcast_conn *c,
-                                const rimeaddr_t *from)
-{
-     struct hop_counter_msg c_msg;
-     memcpy(&c_msg, packetbuf_dataptr(), sizeof(struct hop_counter_msg));
-            
-    PRINTF("DEBUG: hop-count message (hop-count=%d) has been received from node[%d].[%d].\n",
-          c_msg.hop_count,
+bool hop_counter_heard(void *c, const rimeaddr_t *from, uint16_t hop_count){
+    struct bcp_conn *bcp_c = (struct bcp_conn *) c;
+    
+    PRINTF("DEBUG: hop-count %d heard from node[%d].[%d].\n",
+          hop_count,
           from->u8[0], 
           from->u8[1]);
    
     //Update the routing table
-    routing_table_update_hopCount(&current_bcp->routing_table, 
-                                from,
-                                c_msg.hop_count);
-    //Reschedule my hop-count message    
-    if(!isInitialized && ctimer_expired(&hc_timer)){
-        hc_time = CLOCK_SECOND * (random_rand()% maxSeconds);
-        ctimer_set(&hc_timer, hc_time, send_packet,current_bcp);
-    }
+    routing_table_update_hopCount(&bcp_c->routing_table, from, hop_count);
     
+    return hop_counter_update(bcp_c);
 }
 
- static void send_packet(void *ptr)
-{
-    struct bcp_conn *c = ptr;
-    struct hop_counter_msg * m;
-    struct routingtable_item * shortestPath = NULL;
-    
-    //Prepare packetbuf
-    packetbuf_clear();
-    packetbuf_set_datalen(sizeof(struct hop_counter_msg));
-    //Set the packetbuf data
-    m = packetbuf_dataptr();
-    memset(m, 0, sizeof(struct hop_counter_msg));
-    
-    if(c->isSink != 1){
-        shortestPath 
-                    = routing_table_find_shortestPath(&current_bcp->routing_table);
-        if(shortestPath==NULL){
-           m->hop_count = 1; //Because zero means hop-count is not initialized yet
-        }else{
-           m->hop_count = shortestPath->hop_count + 1;
-        }
-    }else{
-         m->hop_count = 1;
-    }
-    
-    
-   if(shortestPath!=NULL){
-        PRINTF("DEBUG: Sending a hop count message (hop-count=%d) to 1-hop neighbors. Shortest parent node[%d].[%d]\n"
-                , m->hop_count, 
-                shortestPath->neighbor.u8[0],
-                shortestPath->neighbor.u8[1]);
-    }else{
-        PRINTF("DEBUG: Sending a hop count message (hop-count=%d) to 1-hop neighbors. p=%p\n"
-                , m->hop_count, shortestPath);
-    }
-    //Send the message
-    broadcast_send(&hc_broadcast_conn);   
-}
-
- 
- static void prepare_phase(void *ptr){
-     struct bcp_conn *c = ptr;
-     if(c->isSink == 1){
-        //Broadcast a hop counter message after a while
-        hc_time = CLOCK_SECOND * (random_rand()% maxSeconds);
-        ctimer_set(&hc_timer, hc_time, send_packet,c); 
-    }
- }
- 
- static void close_phase(void *ptr){
-    //This broadcast channel is no longer required
-    broadcast_close(&hc_broadcast_conn);
- }
 void hop_counter_init(void *c){
-    //Setup bcp
     struct bcp_conn * bcp_c = (struct bcp_conn *) c;
-    current_bcp = bcp_c;
-    isInitialized = false;
-    //Open the broadcast channel
-    broadcast_open(&hc_broadcast_conn, hc_channel, &hc_broadcast_callbacks);
-    
     
     PRINTF("DEBUG: Initializing the hop counter component. \n");
-    //After certain time, check whether this node is sink or not
-    ctimer_set(&hc_timer, prepare_time, prepare_phase,bcp_c); 
-        
+    bcp_c->hop_counter.hop_count = 0;
+}
+
+uint16_t hop_counter_gradient(void *c, uint16_t hop_count){
+    struct bcp_conn *bcp_c = (struct bcp_conn *) c;
+    uint16_t own = bcp_c->hop_counter.hop_count;
+    
+    if(own == 0)
+        return 0;
+    if(hop_count == 0)
+        hop_count = own;
+    //A neighbor more than one hop closer only means that the table is behind
+    if(hop_count + 1 <= own)
+        return 0;
+    return hop_count + 1 - own;
 }
@@ -7,6 +7,25 @@
 #ifndef HOP_COUNTER_H
 #define	HOP_COUNTER_H
 
+#include <stdbool.h>
+#include "net/rime.h"
+
+/**
+ * \brief      The hop counter of a BCP connection
+ *
+ *             The hop counts ride on the beacons and the data packets of BCP,
+ *             so the gradient follows the topology for as long as the 
+ *             connection is open: every packet heard from a neighbor refreshes
+ *             its hop count in the routing table and our own hop count is 
+ *             derived from the table again.
+ */
+struct hop_counter {
+  //Our hop count: one for a sink, otherwise one more than the smallest hop 
+  //count of the neighbors, whichever sink they lead to. Zero until known and 
+  //when the neighbors are HOP_COUNT_MAX hops or more away.
+  uint16_t hop_count;
+};
+
 /**
  * \breif Initializes the hop counter component.
  * 
@@ -14,5 +33,33 @@
  */
 void hop_counter_init(void *c);
 
-#endif	/* HOP_COUNTER_H */
+/**
+ * \breif Records the hop count advertised by a neighbor in a beacon or in a 
+ *        data packet, and derives our own hop count again.
+ * \param c the BCP connection
+ * \param from the neighbor
+ * \param hop_count the hop count of the neighbor, zero if it does not know it
+ * \return true if our own hop count has changed
+ */
+bool hop_counter_heard(void *c, const rimeaddr_t *from, uint16_t hop_count);
 
+/**
+ * \breif Derives our own hop count from the routing table, e.g. after the 
+ *        node became a sink or neighbors have been removed.
+ * \return true if our own hop count has changed
+ */
+bool hop_counter_update(void *c);
+
+/**
+ * \breif Tells how far a neighbor is from the shortest paths to the sink, for
+ *        the weight estimators (see WEIGHT_HOP_V).
+ * \param c the BCP connection
+ * \param hop_count the hop count of the neighbor, zero if it is not known
+ * \return zero for a neighbor one hop closer to the sink than the node, one 
+ * for a neighbor as far as the node (or whose hop count is not known), two 
+ * for a neighbor one hop further, and so on. Zero while our own hop count is
+ * not known.
+ */
+uint16_t hop_counter_gradient(void *c, uint16_t hop_count);
+
+#endif	/* HOP_COUNTER_H */
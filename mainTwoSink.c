@@ -9,6 +9,9 @@
 #include "lib/random.h"
 
 
+//Nodes 1 to NUM_SINKS are sinks
+#define NUM_SINKS 2
+
 #define DEBUG 1
 #if DEBUG
 #include <stdio.h>
@@ -74,6 +77,12 @@ static uint32_t countPack = 0;
   }
   
 
+  //Reports the intake of this sink at every time slot
+  void report_intake(void* v){
+      printf("intake=%lu load=%u\n", (unsigned long) bcp.sink_intake, bcp_backlog(&bcp));
+      ctimer_set(&send_data_timer, time_ee, report_intake, NULL);
+  }
+
   static const struct bcp_callbacks bcp_callbacks = { recv_bcp, sent_bcp };
   static unsigned short solarRnd = 0;
   
@@ -91,39 +100,19 @@ PROCESS_THREAD(main_process, ev, data)
   solarRnd = 1;
   solarRnd += random_rand() % (49);
   printf("solarRnd=%d\n",solarRnd);
-  //Set the sink node
-  addr.u8[0] = 1;
-  addr.u8[1] = 0;
-  
-  char isSink = rimeaddr_cmp(&addr, &rimeaddr_node_addr);
-
-/*
-  if(!isSink){
-       //Set the second sink node
-        addr.u8[0] = 2;
+  //Set the sink nodes
+  char isSink = 0;
+  int k;
+  for(k = 1; k <= NUM_SINKS && !isSink; k++){
+        addr.u8[0] = k;
         addr.u8[1] = 0;
         isSink = rimeaddr_cmp(&addr, &rimeaddr_node_addr);
   }
-  
-   if(!isSink){
-       //Set the second sink node
-        addr.u8[0] = 3;
-        addr.u8[1] = 0;
-        isSink = rimeaddr_cmp(&addr, &rimeaddr_node_addr);
-  }
-  
-   if(!isSink){
-       //Set the second sink node
-        addr.u8[0] = 4;
-        addr.u8[1] = 0;
-        isSink = rimeaddr_cmp(&addr, &rimeaddr_node_addr);
-  }
-*/
 
   
   if(isSink){
       bcp_set_sink(&bcp, true);
-     
+      ctimer_set(&send_data_timer, time_ee, report_intake, NULL);
   }else{
       
        ctimer_set(&send_data_timer, time_ee, sn, NULL);
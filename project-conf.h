@@ -1,3 +1,9 @@
 //#define NETSTACK_CONF_MAC nullmac_driver
 #define NETSTACK_CONF_RDC nullrdc_driver
 //We have modified the /home/user/contiki-2.6-2/platform/cooja file to force CSMA in cooja 
+
+#ifdef FUSION_SHM_RADIO
+//Emulated nodes exchange their frames through the shared memory medium (emu/)
+#undef NETSTACK_CONF_RADIO
+#define NETSTACK_CONF_RADIO shm_radio_driver
+#endif
@@ -2,6 +2,7 @@
 #include "bcp_queue.h"
 #include "sensing_control.h"
 #include "fusion_config.h"
+#include "lpm.h"
 
 static int32_t v = SENSING_V; 
 static int32_t rMax = SENSING_rMax;
@@ -0,0 +1,14 @@
+/**
+ * \file
+ *         Virtual clock of the host simulation (see \ref sys/clock.h).
+ */
+#include "sys/clock.h"
+#include "sim.h"
+
+clock_time_t clock_time(void){
+  return sim_time();
+}
+
+unsigned long clock_seconds(void){
+  return sim_time() / CLOCK_SECOND;
+}
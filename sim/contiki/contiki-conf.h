@@ -0,0 +1,19 @@
+/**
+ * \file
+ *         Platform configuration of the host simulation stand-in. Only the
+ *         settings used by the BCP/fusion sources are provided.
+ */
+#ifndef __CONTIKI_CONF_H__
+#define __CONTIKI_CONF_H__
+
+#include <stdint.h>
+
+//Virtual clock resolution; one tick is one millisecond of simulated time
+#define CLOCK_CONF_SECOND 1000
+typedef unsigned long clock_time_t;
+
+#define RIMEADDR_CONF_SIZE 2
+#define PACKETBUF_CONF_SIZE 128
+#define PACKETBUF_CONF_HDR_SIZE 48
+
+#endif /* __CONTIKI_CONF_H__ */
@@ -0,0 +1,17 @@
+/**
+ * \file
+ *         Stand-in for the Contiki umbrella header used by the host simulation.
+ *         Only the services required by the BCP/fusion sources are available:
+ *         the virtual clock, callback timers, lists, memory blocks and Rime.
+ */
+#ifndef __CONTIKI_H__
+#define __CONTIKI_H__
+
+#include "contiki-conf.h"
+#include "sys/clock.h"
+#include "sys/ctimer.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "lib/random.h"
+
+#endif /* __CONTIKI_H__ */
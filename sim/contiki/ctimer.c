@@ -0,0 +1,101 @@
+/**
+ * \file
+ *         Callback timers of the host simulation (see \ref sys/ctimer.h).
+ *
+ *         The pending timers of a node are kept in a list that is part of the
+ *         node image. The kernel is only asked to wake the node up at the
+ *         earliest expiration time.
+ */
+#include "sys/ctimer.h"
+#include "lib/list.h"
+#include "sim.h"
+
+LIST(ctimer_list);
+//Earliest wake-up time requested from the kernel
+static clock_time_t requested;
+static char has_request;
+//Set while the expired callbacks are being called
+static char running;
+
+static struct ctimer *find_first(void){
+  struct ctimer *c;
+  struct ctimer *first = NULL;
+
+  for(c = list_head(ctimer_list); c != NULL; c = c->next) {
+    if(first == NULL || c->expiry < first->expiry) {
+      first = c;
+    }
+  }
+  return first;
+}
+
+static void schedule(void){
+  struct ctimer *first;
+
+  if(running) {
+    return;
+  }
+  first = find_first();
+  if(first != NULL && (!has_request || first->expiry < requested)) {
+    requested = first->expiry;
+    has_request = 1;
+    sim_timer_request(requested);
+  }
+}
+
+static void start(struct ctimer *c){
+  c->active = 1;
+  list_add(ctimer_list, c);
+  schedule();
+}
+
+void ctimer_set(struct ctimer *c, clock_time_t t,
+                void (*f)(void *), void *ptr){
+  list_remove(ctimer_list, c);
+  c->f = f;
+  c->ptr = ptr;
+  c->interval = t;
+  c->expiry = clock_time() + t;
+  start(c);
+}
+
+void ctimer_reset(struct ctimer *c){
+  list_remove(ctimer_list, c);
+  c->expiry += c->interval;
+  start(c);
+}
+
+void ctimer_restart(struct ctimer *c){
+  list_remove(ctimer_list, c);
+  c->expiry = clock_time() + c->interval;
+  start(c);
+}
+
+void ctimer_stop(struct ctimer *c){
+  list_remove(ctimer_list, c);
+  c->active = 0;
+}
+
+int ctimer_expired(struct ctimer *c){
+  return !c->active;
+}
+
+void ctimer_run(void){
+  struct ctimer *c;
+  clock_time_t now = clock_time();
+
+  //A wake-up requested before an earlier timer was set is still pending
+  if(has_request && requested <= now) {
+    has_request = 0;
+  }
+  running = 1;
+  while((c = find_first()) != NULL && c->expiry <= now) {
+    list_remove(ctimer_list, c);
+    c->active = 0;
+    if(c->f != NULL) {
+      c->f(c->ptr);
+    }
+  }
+  running = 0;
+  schedule();
+}
@@ -0,0 +1,14 @@
+/**
+ * \file
+ *         Pseudo random number generator of the host simulation. Every node
+ *         has its own generator state.
+ */
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+#define RANDOM_RAND_MAX 65535U
+
+void random_init(unsigned short seed);
+unsigned short random_rand(void);
+
+#endif /* __RANDOM_H__ */
@@ -0,0 +1,57 @@
+/**
+ * \file
+ *         Memory block allocator of the host simulation (see \ref lib/memb.h).
+ */
+#include "lib/memb.h"
+#include <string.h>
+
+void memb_init(struct memb *m){
+  memset(m->count, 0, m->num);
+  memset(m->mem, 0, m->size * m->num);
+}
+
+void * memb_alloc(struct memb *m){
+  int i;
+
+  for(i = 0; i < m->num; ++i) {
+    if(m->count[i] == 0) {
+      ++(m->count[i]);
+      return (void *)((char *)m->mem + (i * m->size));
+    }
+  }
+  return NULL;
+}
+
+char memb_free(struct memb *m, void *ptr){
+  int i;
+  char *ptr2;
+
+  ptr2 = (char *)m->mem;
+  for(i = 0; i < m->num; ++i) {
+    if(ptr2 == (char *)ptr) {
+      if(m->count[i] > 0) {
+        --(m->count[i]);
+      }
+      return m->count[i];
+    }
+    ptr2 += m->size;
+  }
+  return -1;
+}
+
+int memb_inmemb(struct memb *m, void *ptr){
+  return (char *)ptr >= (char *)m->mem &&
+    (char *)ptr < (char *)m->mem + (m->num * m->size);
+}
+
+int memb_numfree(struct memb *m){
+  int i;
+  int num_free = 0;
+
+  for(i = 0; i < m->num; ++i) {
+    if(m->count[i] == 0) {
+      ++num_free;
+    }
+  }
+  return num_free;
+}
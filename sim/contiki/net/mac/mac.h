@@ -0,0 +1,17 @@
+/**
+ * \file
+ *         MAC layer return codes used by the host simulation.
+ */
+#ifndef __MAC_H__
+#define __MAC_H__
+
+enum {
+  MAC_TX_OK,
+  MAC_TX_COLLISION,
+  MAC_TX_NOACK,
+  MAC_TX_DEFERRED,
+  MAC_TX_ERR,
+  MAC_TX_ERR_FATAL,
+};
+
+#endif /* __MAC_H__ */
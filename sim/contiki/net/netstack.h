@@ -0,0 +1,11 @@
+/**
+ * \file
+ *         Network stack of the host simulation. Frames sent by Rime are handed
+ *         directly to the simulated radio medium of the simulation kernel.
+ */
+#ifndef __NETSTACK_H__
+#define __NETSTACK_H__
+
+#include "net/mac/mac.h"
+
+#endif /* __NETSTACK_H__ */
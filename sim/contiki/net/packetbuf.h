@@ -0,0 +1,100 @@
+/**
+ * \file
+ *         Packet buffer of the host simulation. Every node has one packetbuf;
+ *         all attributes are carried over the simulated radio.
+ */
+#ifndef __PACKETBUF_H__
+#define __PACKETBUF_H__
+
+#include <stdint.h>
+#include "contiki-conf.h"
+#include "sys/clock.h"
+#include "net/rimeaddr.h"
+
+#define PACKETBUF_SIZE PACKETBUF_CONF_SIZE
+#define PACKETBUF_HDR_SIZE PACKETBUF_CONF_HDR_SIZE
+
+typedef uint16_t packetbuf_attr_t;
+
+struct packetbuf_attr {
+  packetbuf_attr_t val;
+};
+
+struct packetbuf_addr {
+  rimeaddr_t addr;
+};
+
+#define PACKETBUF_ATTR_PACKET_TYPE_DATA      0
+#define PACKETBUF_ATTR_PACKET_TYPE_ACK       1
+#define PACKETBUF_ATTR_PACKET_TYPE_STREAM    2
+#define PACKETBUF_ATTR_PACKET_TYPE_STREAM_END 3
+#define PACKETBUF_ATTR_PACKET_TYPE_TIMESTAMP 4
+
+enum {
+  PACKETBUF_ATTR_NONE,
+  PACKETBUF_ATTR_CHANNEL,
+  PACKETBUF_ATTR_PACKET_ID,
+  PACKETBUF_ATTR_PACKET_TYPE,
+  PACKETBUF_ATTR_EPACKET_ID,
+  PACKETBUF_ATTR_EPACKET_TYPE,
+  PACKETBUF_ATTR_HOPS,
+  PACKETBUF_ATTR_TTL,
+  PACKETBUF_ATTR_MAX_REXMIT,
+  PACKETBUF_ATTR_NUM_REXMIT,
+  PACKETBUF_ATTR_RELIABLE,
+  PACKETBUF_ATTR_RSSI,
+  PACKETBUF_ATTR_LINK_QUALITY,
+
+  /* Address attributes */
+  PACKETBUF_ADDR_SENDER,
+  PACKETBUF_ADDR_RECEIVER,
+  PACKETBUF_ADDR_ESENDER,
+  PACKETBUF_ADDR_ERECEIVER,
+
+  PACKETBUF_ATTR_MAX
+};
+
+#define PACKETBUF_NUM_ADDRS 4
+#define PACKETBUF_NUM_ATTRS (PACKETBUF_ATTR_MAX - PACKETBUF_NUM_ADDRS)
+#define PACKETBUF_ADDR_FIRST PACKETBUF_ADDR_SENDER
+
+#define PACKETBUF_ATTR_BIT  1
+#define PACKETBUF_ATTR_BYTE 8
+#define PACKETBUF_ADDRSIZE (RIMEADDR_SIZE * PACKETBUF_ATTR_BYTE)
+
+struct packetbuf_attrlist {
+  uint8_t type;
+  uint8_t len;
+};
+
+#define PACKETBUF_ATTR_LAST { PACKETBUF_ATTR_NONE, 0 }
+
+void packetbuf_clear(void);
+void *packetbuf_dataptr(void);
+uint16_t packetbuf_datalen(void);
+void packetbuf_set_datalen(uint16_t len);
+uint16_t packetbuf_totlen(void);
+int packetbuf_copyfrom(const void *from, uint16_t len);
+int packetbuf_copyto(void *to);
+
+int packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val);
+packetbuf_attr_t packetbuf_attr(uint8_t type);
+int packetbuf_set_addr(uint8_t type, const rimeaddr_t *addr);
+const rimeaddr_t *packetbuf_addr(uint8_t type);
+
+/**
+ * \breif Copies the attributes of the packetbuf into the given arrays.
+ *
+ *      Used by the Rime stand-in to carry the attributes over the simulated
+ *      radio instead of encoding them in a header.
+ */
+void packetbuf_attr_copyto(struct packetbuf_attr *attrs,
+                           struct packetbuf_addr *addrs);
+
+/**
+ * \breif Restores the packetbuf attributes from the given arrays.
+ */
+void packetbuf_attr_copyfrom(const struct packetbuf_attr *attrs,
+                             const struct packetbuf_addr *addrs);
+
+#endif /* __PACKETBUF_H__ */
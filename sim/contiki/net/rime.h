@@ -0,0 +1,16 @@
+/**
+ * \file
+ *         Stand-in for the Rime umbrella header used by the host simulation.
+ */
+#ifndef __RIME_H__
+#define __RIME_H__
+
+#include "contiki.h"
+#include "net/rimeaddr.h"
+#include "net/packetbuf.h"
+#include "net/rime/channel.h"
+#include "net/rime/broadcast.h"
+#include "net/rime/unicast.h"
+#include "net/rime/runicast.h"
+
+#endif /* __RIME_H__ */
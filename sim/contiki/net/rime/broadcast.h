@@ -0,0 +1,35 @@
+/**
+ * \file
+ *         Best-effort local area broadcast for the host simulation.
+ */
+#ifndef __BROADCAST_H__
+#define __BROADCAST_H__
+
+#include "net/rimeaddr.h"
+#include "net/packetbuf.h"
+#include "net/rime/channel.h"
+
+#define ABC_ATTRIBUTES
+#define BROADCAST_ATTRIBUTES  { PACKETBUF_ADDR_SENDER, PACKETBUF_ADDRSIZE }, \
+                                ABC_ATTRIBUTES
+
+struct broadcast_conn;
+
+struct broadcast_callbacks {
+  void (* recv)(struct broadcast_conn *ptr, const rimeaddr_t *sender);
+  void (* sent)(struct broadcast_conn *ptr, int status, int num_tx);
+};
+
+struct broadcast_conn {
+  //List of the connections opened on this node
+  struct broadcast_conn *next;
+  uint16_t channel;
+  const struct broadcast_callbacks *u;
+};
+
+void broadcast_open(struct broadcast_conn *c, uint16_t channel,
+                    const struct broadcast_callbacks *u);
+void broadcast_close(struct broadcast_conn *c);
+int broadcast_send(struct broadcast_conn *c);
+
+#endif /* __BROADCAST_H__ */
@@ -0,0 +1,17 @@
+/**
+ * \file
+ *         Rime channels of the host simulation.
+ */
+#ifndef __CHANNEL_H__
+#define __CHANNEL_H__
+
+#include "net/packetbuf.h"
+
+/**
+ * Attributes are not encoded into a header by the simulation, so the
+ * attribute list of a channel is accepted and ignored.
+ */
+void channel_set_attributes(uint16_t channelno,
+                            const struct packetbuf_attrlist attrlist[]);
+
+#endif /* __CHANNEL_H__ */
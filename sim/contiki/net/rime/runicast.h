@@ -0,0 +1,44 @@
+/**
+ * \file
+ *         Reliable single-hop unicast for the host simulation. Packets are
+ *         acknowledged and retransmitted by a callback timer.
+ */
+#ifndef __RUNICAST_H__
+#define __RUNICAST_H__
+
+#include "net/rime/unicast.h"
+#include "sys/ctimer.h"
+
+#define RUNICAST_ATTRIBUTES  { PACKETBUF_ATTR_PACKET_TYPE, PACKETBUF_ATTR_BIT }, \
+                             { PACKETBUF_ATTR_PACKET_ID, PACKETBUF_ATTR_BIT * 8 }, \
+                             UNICAST_ATTRIBUTES
+
+struct runicast_conn;
+
+struct runicast_callbacks {
+  void (* recv)(struct runicast_conn *c, const rimeaddr_t *from, uint8_t seqno);
+  void (* sent)(struct runicast_conn *c, const rimeaddr_t *to, uint8_t retransmissions);
+  void (* timedout)(struct runicast_conn *c, const rimeaddr_t *to, uint8_t retransmissions);
+};
+
+struct runicast_conn {
+  struct unicast_conn c;
+  const struct runicast_callbacks *u;
+  struct ctimer rxmit_timer;
+  rimeaddr_t receiver;
+  uint8_t sndnxt;
+  uint8_t is_tx;
+  uint8_t rxmit;
+  uint8_t max_rxmit;
+  uint16_t len;
+  uint8_t buf[PACKETBUF_SIZE];
+};
+
+void runicast_open(struct runicast_conn *c, uint16_t channel,
+                   const struct runicast_callbacks *u);
+void runicast_close(struct runicast_conn *c);
+int runicast_send(struct runicast_conn *c, const rimeaddr_t *receiver,
+                  uint8_t max_retransmissions);
+uint8_t runicast_is_transmitting(struct runicast_conn *c);
+
+#endif /* __RUNICAST_H__ */
@@ -0,0 +1,30 @@
+/**
+ * \file
+ *         Single-hop unicast for the host simulation.
+ */
+#ifndef __UNICAST_H__
+#define __UNICAST_H__
+
+#include "net/rime/broadcast.h"
+
+#define UNICAST_ATTRIBUTES   { PACKETBUF_ADDR_RECEIVER, PACKETBUF_ADDRSIZE }, \
+                        BROADCAST_ATTRIBUTES
+
+struct unicast_conn;
+
+struct unicast_callbacks {
+  void (* recv)(struct unicast_conn *c, const rimeaddr_t *from);
+  void (* sent)(struct unicast_conn *ptr, int status, int num_tx);
+};
+
+struct unicast_conn {
+  struct broadcast_conn c;
+  const struct unicast_callbacks *u;
+};
+
+void unicast_open(struct unicast_conn *c, uint16_t channel,
+                  const struct unicast_callbacks *u);
+void unicast_close(struct unicast_conn *c);
+int unicast_send(struct unicast_conn *c, const rimeaddr_t *receiver);
+
+#endif /* __UNICAST_H__ */
@@ -0,0 +1,81 @@
+/**
+ * \file
+ *         Packet buffer of the host simulation (see \ref net/packetbuf.h).
+ */
+#include "net/packetbuf.h"
+#include <string.h>
+
+static struct packetbuf_attr packetbuf_attrs[PACKETBUF_NUM_ATTRS];
+static struct packetbuf_addr packetbuf_addrs[PACKETBUF_NUM_ADDRS];
+
+static uint16_t buflen;
+//Aligned so that packet structures can be cast onto the data section
+static uint64_t packetbuf_aligned[(PACKETBUF_SIZE + PACKETBUF_HDR_SIZE + 7) / 8];
+static uint8_t *packetbuf = (uint8_t *)packetbuf_aligned;
+
+void packetbuf_clear(void){
+  buflen = 0;
+  memset(packetbuf_attrs, 0, sizeof(packetbuf_attrs));
+  memset(packetbuf_addrs, 0, sizeof(packetbuf_addrs));
+}
+
+void *packetbuf_dataptr(void){
+  return &packetbuf[PACKETBUF_HDR_SIZE];
+}
+
+uint16_t packetbuf_datalen(void){
+  return buflen;
+}
+
+void packetbuf_set_datalen(uint16_t len){
+  buflen = len > PACKETBUF_SIZE? PACKETBUF_SIZE: len;
+}
+
+uint16_t packetbuf_totlen(void){
+  return buflen;
+}
+
+int packetbuf_copyfrom(const void *from, uint16_t len){
+  uint16_t l;
+
+  packetbuf_clear();
+  l = len > PACKETBUF_SIZE? PACKETBUF_SIZE: len;
+  memcpy(packetbuf_dataptr(), from, l);
+  buflen = l;
+  return l;
+}
+
+int packetbuf_copyto(void *to){
+  memcpy(to, packetbuf_dataptr(), buflen);
+  return buflen;
+}
+
+int packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val){
+  packetbuf_attrs[type].val = val;
+  return 1;
+}
+
+packetbuf_attr_t packetbuf_attr(uint8_t type){
+  return packetbuf_attrs[type].val;
+}
+
+int packetbuf_set_addr(uint8_t type, const rimeaddr_t *addr){
+  rimeaddr_copy(&packetbuf_addrs[type - PACKETBUF_ADDR_FIRST].addr, addr);
+  return 1;
+}
+
+const rimeaddr_t *packetbuf_addr(uint8_t type){
+  return &packetbuf_addrs[type - PACKETBUF_ADDR_FIRST].addr;
+}
+
+void packetbuf_attr_copyto(struct packetbuf_attr *attrs,
+                           struct packetbuf_addr *addrs){
+  memcpy(attrs, packetbuf_attrs, sizeof(packetbuf_attrs));
+  memcpy(addrs, packetbuf_addrs, sizeof(packetbuf_addrs));
+}
+
+void packetbuf_attr_copyfrom(const struct packetbuf_attr *attrs,
+                             const struct packetbuf_addr *addrs){
+  memcpy(packetbuf_attrs, attrs, sizeof(packetbuf_attrs));
+  memcpy(packetbuf_addrs, addrs, sizeof(packetbuf_addrs));
+}
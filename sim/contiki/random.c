@@ -0,0 +1,17 @@
+/**
+ * \file
+ *         Pseudo random number generator of the host simulation. The state is
+ *         part of the node image, so every node draws its own sequence.
+ */
+#include "lib/random.h"
+
+static unsigned long rand_state = 1;
+
+void random_init(unsigned short seed){
+  rand_state = seed;
+}
+
+unsigned short random_rand(void){
+  rand_state = rand_state * 1103515245UL + 12345UL;
+  return (unsigned short)((rand_state >> 16) & 0xffff);
+}
@@ -0,0 +1,248 @@
+/**
+ * \file
+ *         Rime stand-in of the host simulation: rime addresses, channels and
+ *         the broadcast, unicast and runicast primitives. Frames are handed
+ *         to the radio medium of the simulation kernel as they are, with all
+ *         the packetbuf attributes attached.
+ */
+#include "net/rime.h"
+#include "net/netstack.h"
+#include "lib/list.h"
+#include "sim.h"
+#include <string.h>
+
+#define RUNICAST_REXMIT_TIME (CLOCK_SECOND / 2)
+
+rimeaddr_t rimeaddr_node_addr;
+const rimeaddr_t rimeaddr_null = { { 0, 0 } };
+
+//The broadcast connections opened on this node
+LIST(channels);
+
+/*********************************RIME ADDRESSES*******************************/
+void rimeaddr_copy(rimeaddr_t *dest, const rimeaddr_t *src){
+  memcpy(dest, src, sizeof(rimeaddr_t));
+}
+
+int rimeaddr_cmp(const rimeaddr_t *addr1, const rimeaddr_t *addr2){
+  return memcmp(addr1, addr2, sizeof(rimeaddr_t)) == 0;
+}
+
+void rimeaddr_set_node_addr(rimeaddr_t *addr){
+  rimeaddr_copy(&rimeaddr_node_addr, addr);
+}
+
+void channel_set_attributes(uint16_t channelno,
+                            const struct packetbuf_attrlist attrlist[]){
+}
+
+static struct broadcast_conn *channel_lookup(uint16_t channel){
+  struct broadcast_conn *c;
+
+  for(c = list_head(channels); c != NULL; c = c->next) {
+    if(c->channel == channel) {
+      return c;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * \breif Hands the packetbuf to the radio medium
+ * \param dst the receiver or NULL for a local broadcast
+ */
+static int rime_output(struct broadcast_conn *c, const rimeaddr_t *dst){
+  struct sim_frame *f = sim_frame_alloc();
+
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &rimeaddr_node_addr);
+  packetbuf_set_attr(PACKETBUF_ATTR_CHANNEL, c->channel);
+
+  f->channel = c->channel;
+  f->dst = dst == NULL? SIM_BROADCAST: sim_node_lookup(dst);
+  f->len = packetbuf_datalen();
+  memcpy(f->data, packetbuf_dataptr(), f->len);
+  packetbuf_attr_copyto(f->attrs, f->addrs);
+
+  sim_radio_transmit(f);
+  return 1;
+}
+
+/**
+ * \breif Loads the given frame into the packetbuf
+ */
+static void rime_load(const struct sim_frame *f){
+  packetbuf_clear();
+  memcpy(packetbuf_dataptr(), f->data, f->len);
+  packetbuf_set_datalen(f->len);
+  packetbuf_attr_copyfrom(f->attrs, f->addrs);
+}
+
+void sim_node_input(const struct sim_frame *f){
+  struct broadcast_conn *c = channel_lookup(f->channel);
+  rimeaddr_t sender;
+
+  if(c == NULL || c->u->recv == NULL) {
+    return;
+  }
+  rime_load(f);
+  rimeaddr_copy(&sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+  c->u->recv(c, &sender);
+}
+
+void sim_node_sent(const struct sim_frame *f){
+  struct broadcast_conn *c = channel_lookup(f->channel);
+
+  if(c == NULL || c->u->sent == NULL) {
+    return;
+  }
+  //Like on the mote, the packet which has been sent is still in the packetbuf
+  rime_load(f);
+  c->u->sent(c, MAC_TX_OK, 1);
+}
+
+/*********************************BROADCAST************************************/
+void broadcast_open(struct broadcast_conn *c, uint16_t channel,
+                    const struct broadcast_callbacks *u){
+  c->channel = channel;
+  c->u = u;
+  list_add(channels, c);
+}
+
+void broadcast_close(struct broadcast_conn *c){
+  list_remove(channels, c);
+}
+
+int broadcast_send(struct broadcast_conn *c){
+  return rime_output(c, NULL);
+}
+
+/*********************************UNICAST**************************************/
+static void recv_from_broadcast(struct broadcast_conn *broadcast,
+                                const rimeaddr_t *from){
+  struct unicast_conn *c = (struct unicast_conn *)broadcast;
+
+  if(rimeaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &rimeaddr_node_addr)
+     && c->u->recv != NULL) {
+    c->u->recv(c, from);
+  }
+}
+
+static void sent_by_broadcast(struct broadcast_conn *broadcast,
+                              int status, int num_tx){
+  struct unicast_conn *c = (struct unicast_conn *)broadcast;
+
+  if(c->u->sent != NULL) {
+    c->u->sent(c, status, num_tx);
+  }
+}
+
+static const struct broadcast_callbacks uc = { recv_from_broadcast,
+                                               sent_by_broadcast };
+
+void unicast_open(struct unicast_conn *c, uint16_t channel,
+                  const struct unicast_callbacks *u){
+  broadcast_open(&c->c, channel, &uc);
+  c->u = u;
+}
+
+void unicast_close(struct unicast_conn *c){
+  broadcast_close(&c->c);
+}
+
+int unicast_send(struct unicast_conn *c, const rimeaddr_t *receiver){
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, receiver);
+  return rime_output(&c->c, receiver);
+}
+
+/*********************************RUNICAST*************************************/
+static void runicast_transmit(struct runicast_conn *c){
+  packetbuf_clear();
+  memcpy(packetbuf_dataptr(), c->buf, c->len);
+  packetbuf_set_datalen(c->len);
+  packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE, PACKETBUF_ATTR_PACKET_TYPE_DATA);
+  packetbuf_set_attr(PACKETBUF_ATTR_PACKET_ID, c->sndnxt);
+  packetbuf_set_attr(PACKETBUF_ATTR_RELIABLE, 1);
+  unicast_send(&c->c, &c->receiver);
+}
+
+static void runicast_rexmit(void *ptr){
+  struct runicast_conn *c = ptr;
+
+  if(c->rxmit >= c->max_rxmit) {
+    c->is_tx = 0;
+    c->sndnxt++;
+    if(c->u->timedout != NULL) {
+      c->u->timedout(c, &c->receiver, c->rxmit);
+    }
+    return;
+  }
+  c->rxmit++;
+  runicast_transmit(c);
+  ctimer_set(&c->rxmit_timer, RUNICAST_REXMIT_TIME, runicast_rexmit, c);
+}
+
+static void recv_from_unicast(struct unicast_conn *uc, const rimeaddr_t *from){
+  struct runicast_conn *c = (struct runicast_conn *)uc;
+  uint8_t seqno = packetbuf_attr(PACKETBUF_ATTR_PACKET_ID);
+  uint8_t data[PACKETBUF_SIZE];
+  uint16_t len;
+
+  if(packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) == PACKETBUF_ATTR_PACKET_TYPE_ACK) {
+    if(c->is_tx && seqno == c->sndnxt && rimeaddr_cmp(from, &c->receiver)) {
+      ctimer_stop(&c->rxmit_timer);
+      c->is_tx = 0;
+      c->sndnxt++;
+      if(c->u->sent != NULL) {
+        c->u->sent(c, from, c->rxmit);
+      }
+    }
+    return;
+  }
+
+  //Keep the data while the ACK is sent through the packetbuf
+  len = packetbuf_copyto(data);
+  packetbuf_clear();
+  packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE, PACKETBUF_ATTR_PACKET_TYPE_ACK);
+  packetbuf_set_attr(PACKETBUF_ATTR_PACKET_ID, seqno);
+  unicast_send(&c->c, from);
+
+  packetbuf_copyfrom(data, len);
+  if(c->u->recv != NULL) {
+    c->u->recv(c, from, seqno);
+  }
+}
+
+static const struct unicast_callbacks runicast = { recv_from_unicast, NULL };
+
+void runicast_open(struct runicast_conn *c, uint16_t channel,
+                   const struct runicast_callbacks *u){
+  unicast_open(&c->c, channel, &runicast);
+  c->u = u;
+  c->is_tx = 0;
+  c->rxmit = 0;
+  c->sndnxt = 0;
+}
+
+void runicast_close(struct runicast_conn *c){
+  ctimer_stop(&c->rxmit_timer);
+  unicast_close(&c->c);
+}
+
+uint8_t runicast_is_transmitting(struct runicast_conn *c){
+  return c->is_tx;
+}
+
+int runicast_send(struct runicast_conn *c, const rimeaddr_t *receiver,
+                  uint8_t max_retransmissions){
+  if(c->is_tx) {
+    return 0;
+  }
+  rimeaddr_copy(&c->receiver, receiver);
+  c->len = packetbuf_copyto(c->buf);
+  c->is_tx = 1;
+  c->rxmit = 0;
+  c->max_rxmit = max_retransmissions;
+  runicast_transmit(c);
+  ctimer_set(&c->rxmit_timer, RUNICAST_REXMIT_TIME, runicast_rexmit, c);
+  return 1;
+}
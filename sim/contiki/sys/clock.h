@@ -0,0 +1,27 @@
+/**
+ * \file
+ *         Virtual clock of the host simulation. The time is owned by the
+ *         simulation kernel and only advances between events.
+ */
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+#include "contiki-conf.h"
+
+#define CLOCK_SECOND CLOCK_CONF_SECOND
+
+//True if the time a is before b, across a wrap of the clock. Contiki takes 
+//the difference as a signed short for its 16 bit clock.
+#define CLOCK_LT(a, b) ((long)((a)-(b)) < 0)
+
+/**
+ * \return the current virtual time in clock ticks
+ */
+clock_time_t clock_time(void);
+
+/**
+ * \return the current virtual time in seconds
+ */
+unsigned long clock_seconds(void);
+
+#endif /* __CLOCK_H__ */
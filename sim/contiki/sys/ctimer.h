@@ -0,0 +1,43 @@
+/**
+ * \file
+ *         Callback timers for the host simulation. Same interface as the
+ *         Contiki ctimer library; expirations are dispatched by the
+ *         simulation kernel on the virtual clock.
+ */
+#ifndef __CTIMER_H__
+#define __CTIMER_H__
+
+#include "sys/clock.h"
+
+struct ctimer {
+  struct ctimer *next;
+  //Absolute expiration time
+  clock_time_t expiry;
+  //Interval used by ctimer_reset/ctimer_restart
+  clock_time_t interval;
+  void (*f)(void *);
+  void *ptr;
+  //Non-zero while the timer is pending
+  char active;
+};
+
+void ctimer_set(struct ctimer *c, clock_time_t t,
+                void (*f)(void *), void *ptr);
+void ctimer_reset(struct ctimer *c);
+void ctimer_restart(struct ctimer *c);
+void ctimer_stop(struct ctimer *c);
+
+/**
+ * \return non-zero if the timer has fired or has been stopped
+ */
+int ctimer_expired(struct ctimer *c);
+
+/**
+ * \breif Runs the callbacks of all timers that are due at the current time.
+ *
+ *      Called by the simulation kernel whenever a timer event of the running
+ *      node is reached.
+ */
+void ctimer_run(void);
+
+#endif /* __CTIMER_H__ */
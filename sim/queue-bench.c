@@ -0,0 +1,275 @@
+/**
+ * \file
+ *         Host benchmark of the bcp_queue backends.
+ *
+ *         Usage: queue-bench-<backend> [-r rounds] [-f fused%] [-S seed] [-o bench.csv]
+ *
+ *         The same program is linked against bcp_queue_lifo.c, bcp_queue_fifo.c
+ *         and bcp_queue_fusion_first.c. It runs the push, pop, remove and
+ *         bcp_queue_element workloads at several queue depths up to
+ *         MAX_PACKET_QUEUE_SIZE with a mix of fused and unfused items laid out
+ *         like the queue items of fusion.c, and prints the mean and worst-case
+ *         latency of every operation together with the memb usage.
+ */
+#include "bcp.h"
+#include "bcp_queue.h"
+#include "lib/memb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#ifndef BENCH_BACKEND
+#define BENCH_BACKEND "unknown"
+#endif
+
+/**
+ * \brief      Same layout as the queue item of fusion.c
+ */
+struct bench_queue_item {
+  struct bench_queue_item *next;
+  char data[MAX_USER_PACKET_SIZE];
+  struct {
+    struct bcp_packet_header bcp_header;
+    char fused;
+    uint16_t CID;
+  } hdr;
+};
+
+MEMB(bench_memb, struct bench_queue_item, MAX_PACKET_QUEUE_SIZE);
+
+enum {
+  BENCH_PUSH,
+  BENCH_POP,
+  BENCH_REMOVE,
+  BENCH_ELEMENT,
+  BENCH_WORKLOADS
+};
+
+static const char *workload_names[BENCH_WORKLOADS] = {
+    "push", "pop", "remove", "element"
+};
+
+static const uint16_t depths[] = {1, 8, 16, MAX_PACKET_QUEUE_SIZE / 2, MAX_PACKET_QUEUE_SIZE};
+#define NUM_DEPTHS (sizeof(depths) / sizeof(depths[0]))
+
+struct bench_result {
+  unsigned long ops;
+  double total_ns;
+  double max_ns;
+  int memb_used; //Peak number of blocks taken from the memb
+};
+
+static struct bcp_conn conn;
+static struct bcp_queue *q;
+static int fused_percent = 30;
+static double timer_overhead_ns;
+
+static double now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void record(struct bench_result *r, double start, double end){
+    double ns = end - start - timer_overhead_ns;
+
+    if(ns < 0)
+        ns = 0;
+    r->ops++;
+    r->total_ns += ns;
+    if(ns > r->max_ns)
+        r->max_ns = ns;
+}
+
+static void record_memb(struct bench_result *r){
+    int used = bench_memb.num - memb_numfree(&bench_memb);
+    if(used > r->memb_used)
+        r->memb_used = used;
+}
+
+/**
+ * \breif Fills the given item with a fusion packet (merged, fusion count in
+ *        the data) or an unfused packet
+ */
+static void make_item(struct bench_queue_item *itm){
+    uint16_t count;
+
+    memset(itm, 0, sizeof(struct bench_queue_item));
+    itm->hdr.bcp_header.packet_length = sizeof(struct bench_queue_item);
+    itm->hdr.CID = 1 + rand() % 2;
+    itm->hdr.bcp_header.delay = rand() % 1000;
+
+    itm->hdr.bcp_header.origin.u8[0] = 1 + rand() % 100;
+    if(rand() % 100 < fused_percent){
+        itm->hdr.bcp_header.merged = 1;
+        count = 2 + rand() % 9;
+        memcpy(itm->data, &count, 2);
+    }else{
+        itm->hdr.fused = rand() % 2;
+        count = rand();
+        memcpy(itm->data, &count, 2);
+    }
+}
+
+static void fill(uint16_t depth, struct bench_result *r){
+    struct bench_queue_item itm;
+
+    while(bcp_queue_length(q) < depth){
+        make_item(&itm);
+        bcp_queue_push(q, (struct bcp_queue_item *)&itm);
+    }
+    record_memb(r);
+}
+
+static void run_push(uint16_t depth, struct bench_result *r){
+    struct bench_queue_item itm;
+    double start;
+
+    while(bcp_queue_length(q) < depth){
+        make_item(&itm);
+        start = now_ns();
+        bcp_queue_push(q, (struct bcp_queue_item *)&itm);
+        record(r, start, now_ns());
+    }
+    record_memb(r);
+    bcp_queue_clear(q);
+}
+
+static void run_pop(uint16_t depth, struct bench_result *r){
+    double start;
+
+    fill(depth, r);
+    while(bcp_queue_top(q) != NULL){
+        start = now_ns();
+        bcp_queue_pop(q);
+        record(r, start, now_ns());
+    }
+}
+
+static void run_remove(uint16_t depth, struct bench_result *r){
+    struct bcp_queue_item *i;
+    int k, len;
+    double start;
+
+    fill(depth, r);
+    //Removes items at random positions, as performFusion does with fused packets
+    while((len = bcp_queue_length(q)) > 0){
+        i = bcp_queue_top(q);
+        for(k = rand() % len; k > 0; k--)
+            i = bcp_queue_next(q, i);
+        start = now_ns();
+        bcp_queue_remove(q, i);
+        record(r, start, now_ns());
+    }
+}
+
+static void run_element(uint16_t depth, struct bench_result *r){
+    struct bcp_queue_item *i;
+    uint16_t k;
+    double start;
+
+    fill(depth, r);
+    for(k = 0; k < depth; k++){
+        start = now_ns();
+        i = bcp_queue_element(q, rand() % depth);
+        record(r, start, now_ns());
+        if(i == NULL){
+            fprintf(stderr, "bcp_queue_element returned NULL at depth %d\n", depth);
+            exit(1);
+        }
+    }
+    bcp_queue_clear(q);
+}
+
+static void (*workloads[BENCH_WORKLOADS])(uint16_t, struct bench_result *) = {
+    run_push, run_pop, run_remove, run_element
+};
+
+static void calibrate(void){
+    double start, min = 1e9, ns;
+    int k;
+
+    for(k = 0; k < 10000; k++){
+        start = now_ns();
+        ns = now_ns() - start;
+        if(ns < min)
+            min = ns;
+    }
+    timer_overhead_ns = min;
+}
+
+static void usage(const char *name){
+    fprintf(stderr,
+            "Usage: %s [-r rounds] [-f fused%%] [-S seed] [-o bench.csv]\n"
+            "  -r  rounds of every workload and depth (default 2000)\n"
+            "  -f  percentage of fused items (default 30)\n"
+            "  -S  random seed (default 1)\n"
+            "  -o  append the results to the given CSV file\n", name);
+}
+
+int main(int argc, char **argv){
+    struct bench_result results[BENCH_WORKLOADS][NUM_DEPTHS];
+    const char *csv = NULL;
+    FILE *out = NULL;
+    int rounds = 2000, seed = 1, w, d, k, c;
+
+    while((c = getopt(argc, argv, "r:f:S:o:h")) != -1){
+        switch(c){
+        case 'r': rounds = atoi(optarg); break;
+        case 'f': fused_percent = atoi(optarg); break;
+        case 'S': seed = atoi(optarg); break;
+        case 'o': csv = optarg; break;
+        default:
+            usage(argv[0]);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+    srand(seed);
+    calibrate();
+
+    LIST_STRUCT_INIT(&conn, packet_queue_list);
+    bcp_queue_init(&conn);
+    conn.packet_queue.memb = &bench_memb;
+    memb_init(&bench_memb);
+    q = &conn.packet_queue;
+
+    memset(results, 0, sizeof(results));
+    for(k = 0; k < rounds; k++)
+        for(w = 0; w < BENCH_WORKLOADS; w++)
+            for(d = 0; d < NUM_DEPTHS; d++)
+                workloads[w](depths[d], &results[w][d]);
+
+    if(csv != NULL){
+        out = fopen(csv, "a");
+        if(out == NULL)
+            perror(csv);
+        else if(ftell(out) == 0)
+            fprintf(out, "backend,workload,depth,fused_percent,ops,ns_per_op,max_ns,memb_used,memb_bytes\n");
+    }
+
+    printf("backend=%s item=%u bytes memb=%u blocks fused=%d%% rounds=%d\n",
+           BENCH_BACKEND, (unsigned)sizeof(struct bench_queue_item),
+           bench_memb.num, fused_percent, rounds);
+    printf("%-8s %5s %10s %10s %10s %10s %10s\n",
+           "workload", "depth", "ops", "ns/op", "max_ns", "memb_used", "memb_bytes");
+    for(w = 0; w < BENCH_WORKLOADS; w++)
+        for(d = 0; d < NUM_DEPTHS; d++){
+            struct bench_result *r = &results[w][d];
+            double mean = r->ops ? r->total_ns / r->ops : 0;
+            unsigned bytes = r->memb_used * sizeof(struct bench_queue_item);
+
+            printf("%-8s %5u %10lu %10.1f %10.0f %10d %10u\n", workload_names[w],
+                   depths[d], r->ops, mean, r->max_ns, r->memb_used, bytes);
+            if(out != NULL)
+                fprintf(out, "%s,%s,%u,%d,%lu,%.1f,%.0f,%d,%u\n", BENCH_BACKEND,
+                        workload_names[w], depths[d], fused_percent, r->ops,
+                        mean, r->max_ns, r->memb_used, bytes);
+        }
+
+    if(out != NULL)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * \file
+ *         Control interface of the simulation kernel, used by the command
+ *         line front end (sim-main.c).
+ */
+#ifndef __SIM_KERNEL_H__
+#define __SIM_KERNEL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim.h"
+
+/**
+ * Kinds of frames seen on the radio medium
+ */
+enum {
+  SIM_FRAME_DATA,
+  SIM_FRAME_ACK,
+  SIM_FRAME_BEACON,
+  SIM_FRAME_BEACON_REQUEST,
+  SIM_FRAME_OTHER,
+  SIM_FRAME_KINDS
+};
+
+/**
+ * \brief      Parameters of a simulation run
+ */
+struct sim_config {
+  uint16_t nodes;
+  //Number of sinks, nodes 1 to sinks
+  uint16_t sinks;
+  //Number of solar trace slots
+  uint16_t slots;
+  //Radio range and side of the square deployment area, in meters
+  double range;
+  double side;
+  //Probability that a frame is lost on a link
+  double loss;
+  uint32_t seed;
+  //Print the output of the nodes
+  bool verbose;
+};
+
+/**
+ * \brief      Per node counters of the radio medium
+ */
+struct sim_node_stats {
+  double x;
+  double y;
+  uint16_t degree;
+  //Hop distance to the nearest sink on the connectivity graph, 0xffff if unreachable
+  uint16_t hops;
+  uint32_t tx_frames[SIM_FRAME_KINDS];
+  uint32_t rx_frames;
+  //Time spent transmitting and receiving, in clock ticks
+  uint64_t tx_time;
+  uint64_t rx_time;
+  uint32_t generated;
+  //Readings of the node received by a sink outside of a fusion packet, the 
+  //first time and again
+  uint32_t delivered;
+  uint32_t duplicates;
+  struct sim_node_report report;
+};
+
+/**
+ * \brief      Network wide results of a simulation run
+ */
+struct sim_stats {
+  uint64_t events;
+  uint64_t generated;
+  //Readings received by a sink, each one once by its kernel id; a fusion 
+  //packet counts for the number of readings fused in it, which cannot be told apart
+  uint64_t delivered;
+  //Readings received by a sink again, outside of a fusion packet
+  uint64_t duplicates;
+  uint64_t delivered_frames;
+  //Sum of the delay carried by the data frames received by the sink, in clock ticks
+  uint64_t e2e_delay;
+  //Number of acknowledged data frame transfers and the sum of the delay they carried
+  uint64_t hops;
+  uint64_t hop_delay;
+  uint64_t tx_frames[SIM_FRAME_KINDS];
+  uint64_t lost_frames;
+  clock_time_t end_time;
+};
+
+/**
+ * \breif Deploys the nodes and boots them
+ * \return zero on success
+ */
+int sim_init(const struct sim_config *cfg);
+
+/**
+ * \breif Runs the event loop until the last slot of the solar trace has passed
+ *        and collects the reports of the nodes.
+ */
+void sim_run(void);
+
+const struct sim_stats *sim_get_stats(void);
+const struct sim_node_stats *sim_get_node_stats(uint16_t index);
+
+/**
+ * \return the size of one node image in bytes
+ */
+unsigned long sim_image_size(void);
+
+#endif /* __SIM_KERNEL_H__ */
@@ -0,0 +1,177 @@
+/**
+ * \file
+ *         Command line front end of the host simulation.
+ *
+ *         Usage: fusion-sim [-n nodes] [-k sinks] [-s slots] [-r range] [-a side]
+ *                           [-d degree] [-l loss] [-S seed] [-o nodes.csv] [-v]
+ *
+ *         Runs the BCP/fusion stack on the given number of nodes over the
+ *         solar trace and prints the delivery ratio, the delays and the
+ *         energy figures of the run.
+ */
+#include "sim-kernel.h"
+#include "bcp-config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+//CC2420 current draw at 3V, used to turn radio time into energy
+#define RADIO_VOLTAGE 3.0
+#define RADIO_TX_MA 17.4
+#define RADIO_RX_MA 18.8
+
+static const char *frame_names[SIM_FRAME_KINDS] = {
+    "data", "ack", "beacon", "beacon_request", "other"
+};
+
+static void usage(const char *name){
+    fprintf(stderr,
+            "Usage: %s [-n nodes] [-k sinks] [-s slots] [-r range] [-a side] [-d degree]\n"
+            "          [-l loss] [-S seed] [-o nodes.csv] [-v]\n"
+            "  -n  number of nodes (default 100)\n"
+            "  -k  number of sinks, nodes 1 to k (default 1)\n"
+            "  -s  number of solar trace slots (default: the whole trace)\n"
+            "  -r  radio range in meters (default 30)\n"
+            "  -a  side of the deployment square in meters\n"
+            "  -d  mean number of neighbors used to size the area when -a is not given (default 10)\n"
+            "  -l  frame loss probability per link (default 0.1)\n"
+            "  -S  random seed (default 1)\n"
+            "  -o  write the per node results to the given CSV file\n"
+            "  -v  print the output of the nodes\n", name);
+}
+
+static double ms(uint64_t ticks){
+    return (double)ticks * 1000.0 / CLOCK_SECOND;
+}
+
+static double radio_mj(uint64_t tx, uint64_t rx){
+    return (RADIO_TX_MA * ms(tx) + RADIO_RX_MA * ms(rx)) * RADIO_VOLTAGE / 1000.0;
+}
+
+static void write_csv(const char *file, uint16_t nodes){
+    FILE *out = fopen(file, "w");
+    uint16_t i;
+    int k;
+
+    if(out == NULL){
+        perror(file);
+        return;
+    }
+    fprintf(out, "node,x,y,degree,hops,generated,delivered,duplicates,queue_length,neighbors,battery_level,rx_frames,radio_mj,beacons_sent,beacons_suppressed,sink_intake,hop_count");
+    for(k = 0; k < SIM_FRAME_KINDS; k++)
+        fprintf(out, ",tx_%s", frame_names[k]);
+    fprintf(out, "\n");
+
+    for(i = 0; i < nodes; i++){
+        const struct sim_node_stats *s = sim_get_node_stats(i);
+        fprintf(out, "%u,%.1f,%.1f,%u,%u,%u,%u,%u,%u,%u,%lu,%u,%.3f,%u,%u,%lu,%u", i + 1, s->x, s->y,
+                s->degree, s->hops, s->generated, s->delivered, s->duplicates, s->report.queue_length,
+                s->report.neighbors, (unsigned long)s->report.battery_level,
+                s->rx_frames, radio_mj(s->tx_time, s->rx_time),
+                s->report.beacons_sent, s->report.beacons_suppressed,
+                (unsigned long)s->report.sink_intake, s->report.hop_count);
+        for(k = 0; k < SIM_FRAME_KINDS; k++)
+            fprintf(out, ",%u", s->tx_frames[k]);
+        fprintf(out, "\n");
+    }
+    fclose(out);
+}
+
+int main(int argc, char **argv){
+    struct sim_config cfg = { 100, 1, 0, 30.0, 0.0, 0.1, 1, false };
+    const struct sim_stats *st;
+    const char *csv = NULL;
+    double degree = 10.0;
+    double wall, radio = 0, battery = 0;
+    uint32_t battery_min = 0xffffffff;
+    uint64_t queued = 0;
+    uint64_t beacons_sent = 0, beacons_suppressed = 0;
+    uint16_t i, unreachable = 0, gradient_exact = 0, gradient_unknown = 0;
+    clock_t start;
+    int opt, k;
+
+    while((opt = getopt(argc, argv, "n:k:s:r:a:d:l:S:o:vh")) != -1){
+        switch(opt){
+        case 'n': cfg.nodes = atoi(optarg); break;
+        case 'k': cfg.sinks = atoi(optarg); break;
+        case 's': cfg.slots = atoi(optarg); break;
+        case 'r': cfg.range = atof(optarg); break;
+        case 'a': cfg.side = atof(optarg); break;
+        case 'd': degree = atof(optarg); break;
+        case 'l': cfg.loss = atof(optarg); break;
+        case 'S': cfg.seed = strtoul(optarg, NULL, 0); break;
+        case 'o': csv = optarg; break;
+        case 'v': cfg.verbose = true; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h'? 0: 1;
+        }
+    }
+    if(cfg.side <= 0)
+        cfg.side = cfg.range * sqrt(M_PI * cfg.nodes / (degree > 1? degree: 1));
+
+    if(sim_init(&cfg) != 0){
+        usage(argv[0]);
+        return 1;
+    }
+
+    start = clock();
+    sim_run();
+    wall = (double)(clock() - start) / CLOCKS_PER_SEC;
+    st = sim_get_stats();
+
+    for(i = 0; i < cfg.nodes; i++){
+        const struct sim_node_stats *s = sim_get_node_stats(i);
+        radio += radio_mj(s->tx_time, s->rx_time);
+        battery += s->report.battery_level;
+        if(i >= cfg.sinks && s->report.battery_level < battery_min)
+            battery_min = s->report.battery_level;
+        queued += s->report.queue_length;
+        beacons_sent += s->report.beacons_sent;
+        beacons_suppressed += s->report.beacons_suppressed;
+        if(s->hops == 0xffff)
+            unreachable++;
+        //The hop counter counts the sink as one hop
+        else if(s->report.hop_count == 0)
+            gradient_unknown++;
+        else if(s->report.hop_count == s->hops + 1)
+            gradient_exact++;
+    }
+
+    printf("nodes=%u slots=%u side=%.0fm range=%.0fm loss=%.2f seed=%u unreachable=%u\n",
+           cfg.nodes, cfg.slots, cfg.side, cfg.range, cfg.loss, cfg.seed, unreachable);
+    printf("simulated=%.0fs wall=%.1fs speedup=%.0fx events=%llu image=%luB\n",
+           ms(st->end_time) / 1000.0, wall, wall > 0? ms(st->end_time) / 1000.0 / wall: 0,
+           (unsigned long long)st->events, sim_image_size());
+    printf("generated=%llu delivered=%llu duplicates=%llu delivered_frames=%llu delivery_ratio=%.3f queued=%llu\n",
+           (unsigned long long)st->generated, (unsigned long long)st->delivered,
+           (unsigned long long)st->duplicates, (unsigned long long)st->delivered_frames,
+           st->generated? (double)st->delivered / st->generated: 0,
+           (unsigned long long)queued);
+    printf("e2e_delay_ms=%.1f hops=%llu frame_delay_ms=%.1f\n",
+           st->delivered_frames? ms(st->e2e_delay) / st->delivered_frames: 0,
+           (unsigned long long)st->hops,
+           st->hops? ms(st->hop_delay) / st->hops: 0);
+    printf("tx_frames");
+    for(k = 0; k < SIM_FRAME_KINDS; k++)
+        printf(" %s=%llu", frame_names[k], (unsigned long long)st->tx_frames[k]);
+    printf(" lost=%llu\n", (unsigned long long)st->lost_frames);
+    printf("beacons sent=%llu suppressed=%llu\n",
+           (unsigned long long)beacons_sent, (unsigned long long)beacons_suppressed);
+    printf("hop_gradient exact=%u unknown=%u reachable=%u\n",
+           gradient_exact, gradient_unknown, cfg.nodes - unreachable);
+    printf("sink_intake");
+    for(i = 0; i < cfg.sinks; i++)
+        printf("%s%lu", i? ",": "=", (unsigned long)sim_get_node_stats(i)->report.sink_intake);
+    printf("\n");
+    printf("radio_energy_mj_per_node=%.1f battery_mean=%.0f battery_min=%lu\n",
+           radio / cfg.nodes, battery / cfg.nodes,
+           (unsigned long)(cfg.nodes > cfg.sinks? battery_min: 0));
+
+    if(csv != NULL)
+        write_csv(csv, cfg.nodes);
+    return 0;
+}
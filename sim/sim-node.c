@@ -0,0 +1,126 @@
+/**
+ * \file
+ *         Application of a simulated node. It plays the role of mainTestpad.c:
+ *         opens a BCP connection and feeds the solar trace into the local
+ *         power management component at the beginning of every time slot.
+ */
+#include <string.h>
+#include "contiki.h"
+#include "net/rime.h"
+#include "bcp.h"
+#include "bcp_queue.h"
+#include "lpm.h"
+#include "solarTrace.h"
+#include "sim.h"
+
+#define SOLAR_TRACE_LENGTH (sizeof(solarTrace) / sizeof(solarTrace[0]))
+
+static struct bcp_conn bcp;
+static struct ctimer slot_timer;
+static clock_time_t slot_time = CLOCK_SECOND * SLOT_DURATION;
+static uint16_t solarCounter; //Count the current time slot
+static uint16_t lastSlot;
+static uint16_t closingQueueLength; //Queue length when BCP was closed
+static uint16_t closingNeighbors; //Routing table length when BCP was closed
+static unsigned short solarRnd; //To generate +- 100% different solar input between nodes
+
+int __real_bcp_send(struct bcp_conn *c);
+
+/**
+ * Every bcp_send() of the node is redirected here by the linker (--wrap) so
+ * that generated packets are counted, and tagged with their kernel id, 
+ * without touching the BCP sources.
+ */
+int __wrap_bcp_send(struct bcp_conn *c){
+    uint32_t id = sim_reading_id();
+    int result;
+    
+#if SIM_READING_IDS
+    //bcp_send() takes MAX_USER_PACKET_SIZE bytes whatever the data length
+    memcpy((uint8_t *)packetbuf_dataptr() + SIM_READING_ID_OFFSET, &id, sizeof(id));
+#endif
+    result = __real_bcp_send(c);
+
+    if(result)
+        sim_stat_generated();
+    return result;
+}
+
+static void recv_bcp(struct bcp_conn *c, rimeaddr_t * from){
+    sim_stat_delivered();
+}
+
+static void sent_bcp(struct bcp_conn *c){
+}
+
+static const struct bcp_callbacks bcp_callbacks = { recv_bcp, sent_bcp };
+
+/**
+ * Called at the beginning of every time slot; same energy model as mainTestpad.c
+ */
+static void new_slot(void *v){
+    unsigned short energy;
+
+    if(solarCounter >= lastSlot){
+        closingQueueLength = bcp_queue_length(&bcp.packet_queue);
+        closingNeighbors = routingtable_length(&bcp.routing_table);
+        bcp_close(&bcp);
+        return;
+    }
+
+    energy = solarTrace[solarCounter++];
+    energy = energy * 34 * 0.071 * 0.1;
+    energy -= (energy * solarRnd) / 100;
+
+    lpm_set_input(energy);
+
+#ifdef SIM_PLAIN_BCP
+    //Without fusion_weight_estimator.c nothing senses; every node but the 
+    //sinks sends SIM_PLAIN_BCP readings per slot
+    if(!bcp.isSink){
+        uint16_t k, d = 258;
+        for(k = 0; k < SIM_PLAIN_BCP; k++){
+            packetbuf_copyfrom(&d, 2);
+            bcp_send(&bcp);
+        }
+    }
+#endif
+
+    ctimer_set(&slot_timer, slot_time, new_slot, NULL);
+}
+
+void sim_node_boot(const struct sim_node_config *cfg){
+    rimeaddr_t addr;
+
+    addr.u8[0] = (cfg->index + 1) & 0xff;
+    addr.u8[1] = (cfg->index + 1) >> 8;
+    rimeaddr_set_node_addr(&addr);
+    random_init(cfg->seed);
+
+    lastSlot = cfg->slots;
+    if(lastSlot > SOLAR_TRACE_LENGTH)
+        lastSlot = SOLAR_TRACE_LENGTH;
+
+    bcp_open(&bcp, 146, &bcp_callbacks);
+    solarRnd = 1;
+    solarRnd += random_rand() % (49);
+
+    if(cfg->isSink)
+        bcp_set_sink(&bcp, true);
+
+    ctimer_set(&slot_timer, slot_time, new_slot, NULL);
+}
+
+void sim_node_report(struct sim_node_report *r){
+    r->battery_level = lpm_get_battery_level();
+    r->queue_length = closingQueueLength;
+    r->neighbors = closingNeighbors;
+    r->beacons_sent = bcp.beacons_sent;
+    r->beacons_suppressed = bcp.beacons_suppressed;
+    r->sink_intake = bcp.sink_intake;
+    r->hop_count = bcp.hop_counter.hop_count;
+}
+
+uint16_t sim_node_trace_length(void){
+    return SOLAR_TRACE_LENGTH;
+}
@@ -0,0 +1,586 @@
+/**
+ * \file
+ *         Discrete-event simulation kernel.
+ *
+ *         Events (timer expirations, frame receptions and the end of frame
+ *         transmissions) are kept in a binary heap ordered by virtual time.
+ *         Before an event is handed to a node, the image of the node (the
+ *         data and bss sections of the node side objects, see the Makefile)
+ *         is swapped in.
+ *
+ *         The radio medium is a unit disk graph with an independent loss
+ *         probability per frame and receiver. Transmissions of one node are
+ *         serialized; collisions are not modelled.
+ */
+#include "sim-kernel.h"
+#include "bcp-config.h"
+#include "bcp_queue.h"
+#include "bcp_wire.h"
+#include "sys/ctimer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+//Radio: 250 kbps with the PHY/MAC/Rime header added to every frame
+#define SIM_BITRATE 250000UL
+#define SIM_FRAME_OVERHEAD 20
+//Nodes boot within the first second
+#define SIM_BOOT_SPREAD CLOCK_SECOND
+//Extension bit set by the fusion component on fusion packets
+#define SIM_FUSION_EXT 1
+
+#define SIM_NO_NODE 0xffff
+
+enum {
+  SIM_EVENT_BOOT,
+  SIM_EVENT_TIMER,
+  SIM_EVENT_RX,
+  SIM_EVENT_TX_DONE
+};
+
+struct sim_event {
+  clock_time_t time;
+  uint64_t seq;
+  struct sim_frame *frame;
+  uint16_t node;
+  uint8_t type;
+};
+
+//Data frames received by a node which has not acknowledged them yet
+#define SIM_UNACKED 8
+
+/**
+ * \breif A data frame waiting for the ACK of its receiver to be accounted
+ */
+struct sim_unacked {
+  //Index of the sender, SIM_NO_NODE if the entry is free
+  uint16_t src;
+  uint8_t seq;
+  clock_time_t delay;
+};
+
+struct sim_node {
+  unsigned char *image;
+  uint32_t *neighbors;
+  clock_time_t radio_free;
+  bool isSink;
+  struct sim_unacked unacked[SIM_UNACKED];
+  uint8_t unacked_next;
+  struct sim_node_stats stats;
+  //Bitmap of the readings of the node received by a sink, by kernel id
+  uint8_t *readings;
+  uint32_t readings_size;
+};
+
+//Boundaries of the node image, provided by the linker
+extern char __start_sim_node_data[], __stop_sim_node_data[];
+extern char __start_sim_node_bss[], __stop_sim_node_bss[];
+
+static struct sim_config config;
+static struct sim_stats stats;
+static struct sim_node *nodes;
+static uint16_t current = SIM_NO_NODE;
+static clock_time_t now;
+
+static struct sim_event *heap;
+static size_t heap_len;
+static size_t heap_size;
+static uint64_t event_seq;
+
+static struct sim_frame *free_frames;
+static uint64_t rng_state;
+
+//Set when the sink hands the frame being received to the user
+static bool delivered;
+
+/*********************************UTILITIES************************************/
+static uint64_t rng_next(void){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double rng_uniform(void){
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void *xmalloc(size_t size){
+    void *p = calloc(1, size);
+    if(p == NULL){
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static size_t data_size(void){
+    return __stop_sim_node_data - __start_sim_node_data;
+}
+
+static size_t bss_size(void){
+    return __stop_sim_node_bss - __start_sim_node_bss;
+}
+
+unsigned long sim_image_size(void){
+    return data_size() + bss_size();
+}
+
+/**
+ * \breif Swaps the image of the given node in
+ */
+static void switch_to(uint16_t n){
+    if(n == current)
+        return;
+    if(current != SIM_NO_NODE){
+        memcpy(nodes[current].image, __start_sim_node_data, data_size());
+        memcpy(nodes[current].image + data_size(), __start_sim_node_bss, bss_size());
+    }
+    memcpy(__start_sim_node_data, nodes[n].image, data_size());
+    memcpy(__start_sim_node_bss, nodes[n].image + data_size(), bss_size());
+    current = n;
+}
+
+/*********************************EVENTS***************************************/
+static bool event_before(const struct sim_event *a, const struct sim_event *b){
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void schedule(clock_time_t time, uint16_t node, uint8_t type,
+                     struct sim_frame *frame){
+    size_t i;
+    struct sim_event e;
+
+    if(heap_len == heap_size){
+        heap_size = heap_size == 0? 1024: heap_size * 2;
+        heap = realloc(heap, heap_size * sizeof(struct sim_event));
+        if(heap == NULL){
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+    }
+    e.time = time;
+    e.seq = event_seq++;
+    e.node = node;
+    e.type = type;
+    e.frame = frame;
+
+    //Sift up
+    for(i = heap_len++; i > 0; i = (i - 1) / 2){
+        if(!event_before(&e, &heap[(i - 1) / 2]))
+            break;
+        heap[i] = heap[(i - 1) / 2];
+    }
+    heap[i] = e;
+}
+
+static struct sim_event pop(void){
+    struct sim_event top = heap[0];
+    struct sim_event last = heap[--heap_len];
+    size_t i = 0;
+    size_t child;
+
+    //Sift down
+    while((child = 2 * i + 1) < heap_len){
+        if(child + 1 < heap_len && event_before(&heap[child + 1], &heap[child]))
+            child++;
+        if(!event_before(&heap[child], &last))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+/*********************************FRAMES***************************************/
+struct sim_frame *sim_frame_alloc(void){
+    struct sim_frame *f = free_frames;
+
+    if(f != NULL)
+        free_frames = f->next;
+    else
+        f = xmalloc(sizeof(struct sim_frame));
+    f->next = NULL;
+    f->refs = 0;
+    return f;
+}
+
+static void frame_release(struct sim_frame *f){
+    if(--f->refs == 0){
+        f->next = free_frames;
+        free_frames = f;
+    }
+}
+
+static int frame_kind(const struct sim_frame *f){
+    switch(f->attrs[PACKETBUF_ATTR_PACKET_TYPE].val){
+    case PACKETBUF_ATTR_PACKET_TYPE_ACK:
+        return SIM_FRAME_ACK;
+    case PACKETBUF_ATTR_PACKET_TYPE_BEACON:
+        return SIM_FRAME_BEACON;
+    case PACKETBUF_ATTR_PACKET_TYPE_BEACON_REQUEST:
+        return SIM_FRAME_BEACON_REQUEST;
+    case PACKETBUF_ATTR_PACKET_TYPE_DATA:
+        if(!rimeaddr_cmp(&f->addrs[PACKETBUF_ADDR_ERECEIVER - PACKETBUF_ADDR_FIRST].addr,
+                         &rimeaddr_null))
+            return SIM_FRAME_DATA;
+    }
+    return SIM_FRAME_OTHER;
+}
+
+static clock_time_t airtime(const struct sim_frame *f){
+    return ((f->len + SIM_FRAME_OVERHEAD) * 8 * CLOCK_SECOND + SIM_BITRATE - 1)
+            / SIM_BITRATE;
+}
+
+/**
+ * \return true if the given frame is a BCP data packet addressed to node n
+ */
+static bool data_addressed_to(const struct sim_frame *f, uint16_t n){
+    return frame_kind(f) == SIM_FRAME_DATA
+            && f->len == BCP_WIRE_DATA_LENGTH
+            && sim_node_lookup(&f->addrs[PACKETBUF_ADDR_ERECEIVER - PACKETBUF_ADDR_FIRST].addr) == n;
+}
+
+/**
+ * \breif Accounts the data frame acknowledged by the given ACK
+ * 
+ *      The ACK may wait for the channel, so a data frame makes its hop when 
+ *      its receiver sends the ACK rather than when it is received.
+ */
+static void acknowledged(struct sim_node *node, const struct sim_frame *f){
+    struct sim_unacked *u;
+
+    for(u = node->unacked; u < node->unacked + SIM_UNACKED; u++){
+        if(u->src != f->dst || u->seq != f->data[0])
+            continue;
+        stats.hops++;
+        stats.hop_delay += u->delay;
+        u->src = SIM_NO_NODE;
+        return;
+    }
+}
+
+void sim_radio_transmit(struct sim_frame *f){
+    struct sim_node *sender = &nodes[current];
+    clock_time_t start = sender->radio_free > now? sender->radio_free: now;
+    clock_time_t end = start + airtime(f);
+    int kind = frame_kind(f);
+    uint32_t *n;
+
+    f->src = current;
+    f->refs = 1;
+    sender->radio_free = end;
+    sender->stats.tx_frames[kind]++;
+    sender->stats.tx_time += end - start;
+    stats.tx_frames[kind]++;
+
+    if(kind == SIM_FRAME_ACK)
+        acknowledged(sender, f);
+
+    for(n = sender->neighbors; *n != SIM_NO_NODE; n++){
+        if(f->dst != SIM_BROADCAST && f->dst != *n)
+            continue;
+        if(rng_uniform() < config.loss){
+            stats.lost_frames++;
+            continue;
+        }
+        f->refs++;
+        schedule(end, *n, SIM_EVENT_RX, f);
+    }
+    schedule(end, current, SIM_EVENT_TX_DONE, f);
+}
+
+uint16_t sim_node_lookup(const rimeaddr_t *addr){
+    uint16_t id = addr->u8[0] | (addr->u8[1] << 8);
+
+    if(id == 0 || id > config.nodes)
+        return SIM_BROADCAST;
+    return id - 1;
+}
+
+/**
+ * \breif Accounts a reading received by a sink; only the first copy of every 
+ *        kernel id is delivered, the others are duplicates
+ */
+static void deliver_reading(const struct bcp_queue_item *itm){
+    uint16_t origin = sim_node_lookup(&itm->hdr.origin);
+    struct sim_node *n;
+    uint32_t id;
+
+    if(origin == SIM_BROADCAST)
+        return;
+    n = &nodes[origin];
+#if !SIM_READING_IDS
+    n->stats.delivered++;
+    stats.delivered++;
+    return;
+#endif
+    memcpy(&id, itm->data + SIM_READING_ID_OFFSET, sizeof(id));
+    if(id >= n->stats.generated)
+        return;
+
+    if(n->readings[id / 8] & (1 << (id % 8))){
+        n->stats.duplicates++;
+        stats.duplicates++;
+    }else{
+        n->readings[id / 8] |= 1 << (id % 8);
+        n->stats.delivered++;
+        stats.delivered++;
+    }
+}
+
+/**
+ * \breif Delivers a frame to the current node and accounts the BCP traffic
+ */
+static void receive(struct sim_frame *f){
+    struct sim_node *node = &nodes[current];
+    struct sim_unacked *u;
+    struct bcp_queue_item itm;
+    uint8_t ext, seq;
+    uint16_t hops;
+    bool isData = data_addressed_to(f, current)
+                  && bcp_wire_decode(f->data, f->len, &itm, &ext, &hops, &seq);
+
+    node->stats.rx_frames++;
+    node->stats.rx_time += airtime(f);
+
+    //The hop is accounted when the frame is acknowledged, which may be later
+    if(isData){
+        u = &node->unacked[node->unacked_next];
+        node->unacked_next = (node->unacked_next + 1) % SIM_UNACKED;
+        u->src = f->src;
+        u->seq = seq;
+        u->delay = itm.hdr.delay;
+    }
+
+    delivered = false;
+    sim_node_input(f);
+
+    //A retransmission is not delivered twice
+    if(isData && node->isSink && delivered){
+        uint16_t count;
+        if(ext & SIM_FUSION_EXT){
+            memcpy(&count, itm.data, sizeof(count));
+            stats.delivered += count;
+        }else
+            deliver_reading(&itm);
+        stats.delivered_frames++;
+        stats.e2e_delay += itm.hdr.delay;
+    }
+}
+
+/*********************************NODE SERVICES********************************/
+clock_time_t sim_time(void){
+    return now;
+}
+
+void sim_timer_request(clock_time_t when){
+    schedule(when, current, SIM_EVENT_TIMER, NULL);
+}
+
+uint32_t sim_reading_id(void){
+    return nodes[current].stats.generated;
+}
+
+void sim_stat_generated(void){
+    struct sim_node *n = &nodes[current];
+
+    //The bitmap covers every kernel id given so far
+    if(n->stats.generated / 8 >= n->readings_size){
+        uint32_t size = n->readings_size == 0? 64: n->readings_size * 2;
+        n->readings = realloc(n->readings, size);
+        if(n->readings == NULL){
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+        memset(n->readings + n->readings_size, 0, size - n->readings_size);
+        n->readings_size = size;
+    }
+    stats.generated++;
+    n->stats.generated++;
+}
+
+void sim_stat_delivered(void){
+    delivered = true;
+}
+
+int sim_node_printf(const char *fmt, ...){
+    va_list ap;
+    int r;
+
+    if(!config.verbose)
+        return 0;
+    printf("%lu\t%u\t", (unsigned long)now, current + 1);
+    va_start(ap, fmt);
+    r = vprintf(fmt, ap);
+    va_end(ap);
+    return r;
+}
+
+/*********************************TOPOLOGY*************************************/
+/**
+ * \breif Places the nodes uniformly at random, the sinks evenly along the 
+ *        middle line (one sink is in the center), and builds the neighbor 
+ *        lists with a grid of cells of one radio range.
+ */
+static void deploy(void){
+    int cells = (int)(config.side / config.range) + 1;
+    uint32_t *head = xmalloc(sizeof(uint32_t) * cells * cells);
+    uint32_t *next = xmalloc(sizeof(uint32_t) * config.nodes);
+    uint32_t *buf = xmalloc(sizeof(uint32_t) * (config.nodes + 1));
+    uint16_t *queue = xmalloc(sizeof(uint16_t) * config.nodes);
+    int i, cx, cy, dx, dy, count, qh, qt;
+    uint32_t j;
+
+    for(i = 0; i < cells * cells; i++)
+        head[i] = SIM_NO_NODE;
+
+    for(i = 0; i < config.nodes; i++){
+        struct sim_node_stats *s = &nodes[i].stats;
+        if(i < config.sinks){
+            s->x = config.side * (i + 1) / (config.sinks + 1);
+            s->y = config.side / 2;
+        }else{
+            s->x = rng_uniform() * config.side;
+            s->y = rng_uniform() * config.side;
+        }
+        cx = (int)(s->x / config.range);
+        cy = (int)(s->y / config.range);
+        next[i] = head[cy * cells + cx];
+        head[cy * cells + cx] = i;
+    }
+
+    for(i = 0; i < config.nodes; i++){
+        struct sim_node_stats *s = &nodes[i].stats;
+        cx = (int)(s->x / config.range);
+        cy = (int)(s->y / config.range);
+        count = 0;
+        for(dy = -1; dy <= 1; dy++){
+            for(dx = -1; dx <= 1; dx++){
+                if(cx + dx < 0 || cy + dy < 0 || cx + dx >= cells || cy + dy >= cells)
+                    continue;
+                for(j = head[(cy + dy) * cells + cx + dx]; j != SIM_NO_NODE; j = next[j]){
+                    double ddx = nodes[j].stats.x - s->x;
+                    double ddy = nodes[j].stats.y - s->y;
+                    if(j != (uint32_t)i && ddx * ddx + ddy * ddy <= config.range * config.range)
+                        buf[count++] = j;
+                }
+            }
+        }
+        buf[count] = SIM_NO_NODE;
+        nodes[i].neighbors = xmalloc(sizeof(uint32_t) * (count + 1));
+        memcpy(nodes[i].neighbors, buf, sizeof(uint32_t) * (count + 1));
+        s->degree = count;
+        s->hops = 0xffff;
+    }
+
+    //Hop distances from the nearest sink
+    for(qt = 0; qt < config.sinks; qt++){
+        nodes[qt].stats.hops = 0;
+        queue[qt] = qt;
+    }
+    for(qh = 0; qh < qt; qh++){
+        uint16_t n = queue[qh];
+        for(i = 0; nodes[n].neighbors[i] != SIM_NO_NODE; i++){
+            j = nodes[n].neighbors[i];
+            if(nodes[j].stats.hops == 0xffff){
+                nodes[j].stats.hops = nodes[n].stats.hops + 1;
+                queue[qt++] = j;
+            }
+        }
+    }
+
+    free(head);
+    free(next);
+    free(buf);
+    free(queue);
+}
+
+/*********************************CONTROL**************************************/
+int sim_init(const struct sim_config *cfg){
+    unsigned char *pristine;
+    uint16_t i;
+    uint8_t j;
+
+    config = *cfg;
+    if(config.nodes == 0 || config.nodes >= SIM_NO_NODE
+            || config.sinks == 0 || config.sinks > config.nodes)
+        return -1;
+    if(config.slots == 0 || config.slots > sim_node_trace_length())
+        config.slots = sim_node_trace_length();
+    rng_state = ((uint64_t)config.seed << 32) ^ 0x9e3779b97f4a7c15ULL;
+
+    nodes = xmalloc(sizeof(struct sim_node) * config.nodes);
+    deploy();
+
+    //Every node starts from the image the program was loaded with
+    pristine = xmalloc(sim_image_size());
+    memcpy(pristine, __start_sim_node_data, data_size());
+    memcpy(pristine + data_size(), __start_sim_node_bss, bss_size());
+    for(i = 0; i < config.nodes; i++){
+        nodes[i].image = xmalloc(sim_image_size());
+        memcpy(nodes[i].image, pristine, sim_image_size());
+        nodes[i].isSink = (i < config.sinks);
+        for(j = 0; j < SIM_UNACKED; j++)
+            nodes[i].unacked[j].src = SIM_NO_NODE;
+        schedule(rng_next() % SIM_BOOT_SPREAD, i, SIM_EVENT_BOOT, NULL);
+    }
+    free(pristine);
+
+    stats.end_time = (clock_time_t)(config.slots + 2) * SLOT_DURATION * CLOCK_SECOND
+            + SIM_BOOT_SPREAD;
+    return 0;
+}
+
+void sim_run(void){
+    struct sim_event e;
+    struct sim_node_config nc;
+    uint16_t i;
+
+    while(heap_len > 0 && heap[0].time <= stats.end_time){
+        e = pop();
+        now = e.time;
+        stats.events++;
+        switch_to(e.node);
+
+        switch(e.type){
+        case SIM_EVENT_BOOT:
+            nc.index = e.node;
+            nc.isSink = nodes[e.node].isSink;
+            nc.slots = config.slots;
+            nc.seed = (uint16_t)(config.seed * 31 + e.node + 1);
+            sim_node_boot(&nc);
+            break;
+        case SIM_EVENT_TIMER:
+            ctimer_run();
+            break;
+        case SIM_EVENT_RX:
+            receive(e.frame);
+            frame_release(e.frame);
+            break;
+        case SIM_EVENT_TX_DONE:
+            sim_node_sent(e.frame);
+            frame_release(e.frame);
+            break;
+        }
+    }
+
+    now = stats.end_time;
+    for(i = 0; i < config.nodes; i++){
+        switch_to(i);
+        sim_node_report(&nodes[i].stats.report);
+    }
+}
+
+const struct sim_stats *sim_get_stats(void){
+    return &stats;
+}
+
+const struct sim_node_stats *sim_get_node_stats(uint16_t index){
+    return &nodes[index].stats;
+}
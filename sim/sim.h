@@ -0,0 +1,149 @@
+/**
+ * \file
+ *         Interface between the simulation kernel and the simulated nodes.
+ *
+ *         The host simulation links the unmodified BCP/fusion sources once.
+ *         Every node owns a private copy of their global and static
+ *         variables (the "node image"); the kernel swaps the image of a node
+ *         in before any of its code runs. All node side code (the BCP/fusion
+ *         sources, the Contiki stand-ins and sim-node.c) therefore only sees
+ *         its own state, exactly as on a mote.
+ *
+ *         Functions prefixed with sim_node_ are implemented by the node side
+ *         and are only called by the kernel with the node image swapped in.
+ *         All the other sim_ functions are implemented by the kernel.
+ */
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "contiki-conf.h"
+#include "net/rimeaddr.h"
+#include "net/packetbuf.h"
+
+/**
+ * \brief      A frame travelling over the simulated radio medium
+ */
+struct sim_frame {
+  //Free list of the kernel
+  struct sim_frame *next;
+  //Number of pending events referring to the frame
+  uint16_t refs;
+  //Index of the sending node
+  uint16_t src;
+  //Index of the receiving node or SIM_BROADCAST
+  uint16_t dst;
+  //Rime channel
+  uint16_t channel;
+  //Length of the data section
+  uint16_t len;
+  struct packetbuf_attr attrs[PACKETBUF_NUM_ATTRS];
+  struct packetbuf_addr addrs[PACKETBUF_NUM_ADDRS];
+  uint8_t data[PACKETBUF_SIZE];
+};
+
+#define SIM_BROADCAST 0xffff
+
+/**
+ * \brief      Start-up parameters of a simulated node
+ */
+struct sim_node_config {
+  //Index of the node; the rime address is index + 1
+  uint16_t index;
+  bool isSink;
+  //Number of solar trace slots to run before closing BCP
+  uint16_t slots;
+  uint16_t seed;
+};
+
+/**
+ * \brief      State of a simulated node collected at the end of a run
+ */
+struct sim_node_report {
+  uint32_t battery_level;
+  //Queue length when the last slot ended
+  uint16_t queue_length;
+  uint16_t neighbors;
+  //Beacons sent and suppressed by BCP
+  uint16_t beacons_sent;
+  uint16_t beacons_suppressed;
+  //Data packets taken in by a sink, as counted by BCP
+  uint32_t sink_intake;
+  //Hop count kept by the hop counter, one for a sink and zero if unknown
+  uint16_t hop_count;
+};
+
+/*********************************KERNEL***************************************/
+/**
+ * \return the current virtual time
+ */
+clock_time_t sim_time(void);
+
+/**
+ * \breif Asks the kernel to run the timers of the current node at the given time
+ */
+void sim_timer_request(clock_time_t when);
+
+/**
+ * \return an empty frame owned by the caller until it is transmitted
+ */
+struct sim_frame *sim_frame_alloc(void);
+
+/**
+ * \breif Transmits the given frame from the current node.
+ *
+ *      The kernel takes the ownership of the frame. sim_node_sent() is
+ *      called on the sender once the frame has left the radio.
+ */
+void sim_radio_transmit(struct sim_frame *f);
+
+/**
+ * \return the index of the node with the given rime address or SIM_BROADCAST
+ */
+uint16_t sim_node_lookup(const rimeaddr_t *addr);
+
+/**
+ * Every reading generated by a node carries its kernel id, the number of 
+ * readings generated before it by its origin, in the last bytes of the data
+ * section (MAX_USER_PACKET_SIZE); the reading itself is in the first bytes.
+ */
+#define SIM_READING_ID_SIZE 4
+#define SIM_READING_ID_OFFSET (MAX_USER_PACKET_SIZE - SIM_READING_ID_SIZE)
+//The readings are two bytes long (fusion_weight_estimator.c). Without room
+//for the kernel id, every copy received by a sink counts as delivered.
+#define SIM_READING_IDS (SIM_READING_ID_OFFSET >= 2)
+
+/**
+ * \return the kernel id of the next reading generated by the current node
+ */
+uint32_t sim_reading_id(void);
+/**
+ * \breif Records a data packet accepted by bcp_send() on the current node. It
+ *        carries the id returned by sim_reading_id().
+ */
+void sim_stat_generated(void);
+
+/**
+ * \breif Records that the sink handed the data packet being received to the user
+ */
+void sim_stat_delivered(void);
+
+/**
+ * \breif Output of the node side printf(). Discarded unless the run is verbose.
+ */
+int sim_node_printf(const char *fmt, ...);
+
+/*********************************NODE SIDE************************************/
+void sim_node_boot(const struct sim_node_config *cfg);
+void sim_node_input(const struct sim_frame *f);
+void sim_node_sent(const struct sim_frame *f);
+void sim_node_report(struct sim_node_report *r);
+
+/**
+ * \return the number of slots in the solar trace. Reads constant data only,
+ *         so no node image is required.
+ */
+uint16_t sim_node_trace_length(void);
+
+#endif /* __SIM_H__ */
@@ -0,0 +1,151 @@
+#include "sink_output.h"
+#include "bcp.h"
+#include "bcp_extend.h"
+#include "contiki.h"
+#include "dev/slip.h"
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+//Writes one byte to the serial port
+#ifndef SINK_OUTPUT_WRITEB
+#define SINK_OUTPUT_WRITEB(b) slip_arch_writeb(b)
+#endif
+
+//A framed record: END, every byte escaped at worst, END
+#define SINK_FRAME_MAX (2 + 2 * SINK_RECORD_SIZE)
+
+#if SINK_OUTPUT_BUFFER < SINK_FRAME_MAX
+#error "SINK_OUTPUT_BUFFER cannot hold a single record"
+#endif
+
+//The ring of framed records waiting for the serial port
+static uint8_t ring[SINK_OUTPUT_BUFFER];
+static uint16_t ring_head;
+static uint16_t ring_count;
+
+static uint8_t seq;
+static uint16_t dropped;
+
+PROCESS(sink_output_process, "Sink output");
+
+/**
+ * Appends the SLIP encoding of b to the frame f at position n.
+ *
+ * \return the new length of the frame
+ */
+static uint8_t slip_put(uint8_t *f, uint8_t n, uint8_t b){
+    if(b == SLIP_END){
+        f[n++] = SLIP_ESC;
+        f[n++] = SLIP_ESC_END;
+    }else if(b == SLIP_ESC){
+        f[n++] = SLIP_ESC;
+        f[n++] = SLIP_ESC_ESC;
+    }else{
+        f[n++] = b;
+    }
+    return n;
+}
+
+void sink_output_init(void){
+    if(!process_is_running(&sink_output_process))
+        process_start(&sink_output_process, NULL);
+}
+
+bool sink_output_write(const struct sink_record *r){
+    uint8_t rec[SINK_RECORD_SIZE];
+    uint8_t frame[SINK_FRAME_MAX];
+    uint8_t i, n, check = 0;
+    uint16_t tail;
+
+    rec[0] = SINK_RECORD_MAGIC;
+    rec[1] = seq;
+    rec[2] = r->origin.u8[0];
+    rec[3] = r->origin.u8[1];
+    rec[4] = r->count & 0xFF;
+    rec[5] = r->count >> 8;
+    rec[6] = r->cid;
+    rec[7] = r->delay & 0xFF;
+    rec[8] = (r->delay >> 8) & 0xFF;
+    rec[9] = (r->delay >> 16) & 0xFF;
+    rec[10] = r->delay >> 24;
+    memcpy(&rec[11], r->payload, MAX_USER_PACKET_SIZE);
+
+    //The sequence number advances even if the record is dropped, so the host
+    //can count the drops
+    seq++;
+
+    //Frame the record, the leading END flushes any noise on the line
+    n = 0;
+    frame[n++] = SLIP_END;
+    for(i = 0; i < SINK_RECORD_SIZE - 1; i++){
+        check ^= rec[i];
+        n = slip_put(frame, n, rec[i]);
+    }
+    n = slip_put(frame, n, check);
+    frame[n++] = SLIP_END;
+
+    if(SINK_OUTPUT_BUFFER - ring_count < n){
+        dropped++;
+        PRINTF("DEBUG: Sink output ring is full, record dropped (total=%d)\n", dropped);
+        return false;
+    }
+
+    tail = (ring_head + ring_count) % SINK_OUTPUT_BUFFER;
+    for(i = 0; i < n; i++){
+        ring[tail] = frame[i];
+        tail = (tail + 1) % SINK_OUTPUT_BUFFER;
+    }
+    ring_count += n;
+
+    process_poll(&sink_output_process);
+    return true;
+}
+
+bool sink_output_packet(struct bcp_conn *c, struct bcp_queue_item *itm){
+    struct sink_record r;
+
+    rimeaddr_copy(&r.origin, &itm->hdr.origin);
+    r.count = 1;
+    r.cid = 0;
+    r.delay = itm->hdr.delay;
+    memcpy(r.payload, itm->data, MAX_USER_PACKET_SIZE);
+
+    if(c->ce != NULL && c->ce->describeData != NULL)
+        c->ce->describeData(c, itm, &r.count, &r.cid);
+
+    return sink_output_write(&r);
+}
+
+uint16_t sink_output_dropped(void){
+    return dropped;
+}
+
+PROCESS_THREAD(sink_output_process, ev, data)
+{
+    PROCESS_BEGIN();
+
+    for(;;){
+        uint8_t burst = 0;
+
+        PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+
+        //Write a burst and give the other processes a turn before the next one
+        while(ring_count > 0 && burst < SINK_OUTPUT_BURST){
+            SINK_OUTPUT_WRITEB(ring[ring_head]);
+            ring_head = (ring_head + 1) % SINK_OUTPUT_BUFFER;
+            ring_count--;
+            burst++;
+        }
+        if(ring_count > 0)
+            process_poll(&sink_output_process);
+    }
+
+    PROCESS_END();
+}
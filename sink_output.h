@@ -0,0 +1,80 @@
+/**
+ * \file
+ *         Binary output of the packets delivered at a sink.
+ *
+ *         Every packet the sink takes in becomes a fixed size record, framed
+ *         with SLIP (RFC 1055) and queued in a RAM ring. A process drains the
+ *         ring to the serial port a few bytes at a time, so the event loop
+ *         never waits for the UART. When the ring is full the record is
+ *         dropped and counted; the host sees the drop as a gap in the record
+ *         sequence numbers. tools/sink-decode turns the serial stream into a
+ *         columnar file.
+ *
+ *         Enabled with SINK_OUTPUT_BINARY (see bcp-config.h), otherwise the
+ *         sink prints the delay of every packet as text.
+ */
+
+#ifndef SINK_OUTPUT_H
+#define	SINK_OUTPUT_H
+
+#include "bcp.h"
+
+//First byte of every record
+#define SINK_RECORD_MAGIC 0xFB
+
+//SLIP special bytes
+#define SLIP_END     0xC0
+#define SLIP_ESC     0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+/**
+ * Size in bytes of an unframed record. All the fields are little endian:
+ *   magic    u8    SINK_RECORD_MAGIC
+ *   seq      u8    record sequence number, increases by one per record
+ *   origin   u8[2] rime address of the source node
+ *   count    u16   number of packets the record stands for (fused count)
+ *   cid      u8    correlation ID of the packet
+ *   delay    u32   delay of the packet in clock ticks
+ *   payload  u8[MAX_USER_PACKET_SIZE]
+ *   check    u8    XOR of all the previous bytes
+ */
+#define SINK_RECORD_SIZE (12 + MAX_USER_PACKET_SIZE)
+
+/**
+ * \breif A packet delivered at the sink
+ */
+struct sink_record {
+  rimeaddr_t origin;
+  uint16_t count;
+  uint8_t cid;
+  uint32_t delay;
+  uint8_t payload[MAX_USER_PACKET_SIZE];
+};
+
+/**
+ * \breif Starts the process which drains the output ring. Calling it again
+ *        has no effect.
+ */
+void sink_output_init(void);
+
+/**
+ * \breif Queues a record for the serial port.
+ *
+ * \return false if the ring was full and the record has been dropped
+ */
+bool sink_output_write(const struct sink_record *r);
+
+/**
+ * \breif Queues the record of a data packet delivered at the sink of c. The
+ *        fused count and the CID are given by the extender of c, if any.
+ */
+bool sink_output_packet(struct bcp_conn *c, struct bcp_queue_item *itm);
+
+/**
+ * \return the number of records dropped since the start because the ring was
+ *         full
+ */
+uint16_t sink_output_dropped(void);
+
+#endif	/* SINK_OUTPUT_H */
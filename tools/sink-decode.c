@@ -0,0 +1,219 @@
+/**
+ * \file
+ *         Decodes the binary output of a sink (see sink_output.h).
+ *
+ *         Reads the SLIP framed records captured from the serial port of the
+ *         sink and writes them as a columnar file. Frames which are not
+ *         records (e.g. text printed by the node between two records) are
+ *         skipped, and the gaps in the record sequence numbers give the
+ *         records the sink dropped because its ring was full.
+ *
+ *         The columnar file is little endian:
+ *           header   "FSNK", u16 version (1), u16 payload size,
+ *                    u32 records, u32 clock ticks per second
+ *           seq      u8[records]
+ *           origin   u16[records], rime address u8[0] | u8[1] << 8
+ *           count    u16[records]
+ *           cid      u8[records]
+ *           delay    u32[records], in clock ticks
+ *           payload  u8[records * payload size]
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SINK_RECORD_MAGIC 0xFB
+#define SLIP_END     0xC0
+#define SLIP_ESC     0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+//Record without its payload: magic, seq, origin, count, cid, delay and check
+#define RECORD_FIXED 12
+#define MAX_PAYLOAD 64
+
+struct columns {
+    size_t rows, size;
+    uint8_t *seq, *cid, *payload;
+    uint16_t *origin, *count;
+    uint32_t *delay;
+};
+
+static void usage(const char *prog){
+    fprintf(stderr,
+            "Usage: %s [options] [input]\n"
+            "  -o file    columnar output file (default sink.col)\n"
+            "  -p bytes   payload size, MAX_USER_PACKET_SIZE of the nodes (default 6)\n"
+            "  -c ticks   clock ticks per second of the nodes (default 128)\n"
+            "The input is read from stdin when it is not given.\n",
+            prog);
+}
+
+static void *grow(void *p, size_t n){
+    p = realloc(p, n);
+    if(p == NULL){
+        perror("realloc");
+        exit(1);
+    }
+    return p;
+}
+
+static void add_row(struct columns *t, const uint8_t *r, int payload){
+    size_t i = t->rows;
+
+    if(t->rows == t->size){
+        t->size = t->size ? 2 * t->size : 1024;
+        t->seq = grow(t->seq, t->size);
+        t->origin = grow(t->origin, t->size * sizeof(uint16_t));
+        t->count = grow(t->count, t->size * sizeof(uint16_t));
+        t->cid = grow(t->cid, t->size);
+        t->delay = grow(t->delay, t->size * sizeof(uint32_t));
+        t->payload = grow(t->payload, t->size * payload);
+    }
+    t->seq[i] = r[1];
+    t->origin[i] = r[2] | r[3] << 8;
+    t->count[i] = r[4] | r[5] << 8;
+    t->cid[i] = r[6];
+    t->delay[i] = r[7] | r[8] << 8 | r[9] << 16 | (uint32_t) r[10] << 24;
+    memcpy(t->payload + i * payload, r + 11, payload);
+    t->rows++;
+}
+
+/**
+ * \return 1 if the frame f of n bytes is a valid record
+ */
+static int is_record(const uint8_t *f, int n, int payload){
+    uint8_t check = 0;
+    int i;
+
+    if(n != RECORD_FIXED + payload || f[0] != SINK_RECORD_MAGIC)
+        return 0;
+    for(i = 0; i < n - 1; i++)
+        check ^= f[i];
+    return check == f[n - 1];
+}
+
+static void put16(uint8_t *b, uint16_t v){
+    b[0] = v;
+    b[1] = v >> 8;
+}
+
+static void put32(uint8_t *b, uint32_t v){
+    put16(b, v);
+    put16(b + 2, v >> 16);
+}
+
+static int write_columns(const char *path, const struct columns *t, int payload, int ticks){
+    uint8_t header[16], *buf;
+    size_t i, size = t->rows * 4;
+    FILE *out;
+    int ok;
+
+    out = fopen(path, "wb");
+    if(out == NULL){
+        perror(path);
+        return -1;
+    }
+    memcpy(header, "FSNK", 4);
+    put16(header + 4, 1);
+    put16(header + 6, payload);
+    put32(header + 8, t->rows);
+    put32(header + 12, ticks);
+    fwrite(header, 1, sizeof(header), out);
+
+    //Wide columns are converted to little endian in one buffer
+    buf = grow(NULL, size ? size : 1);
+    fwrite(t->seq, 1, t->rows, out);
+    for(i = 0; i < t->rows; i++)
+        put16(buf + 2 * i, t->origin[i]);
+    fwrite(buf, 2, t->rows, out);
+    for(i = 0; i < t->rows; i++)
+        put16(buf + 2 * i, t->count[i]);
+    fwrite(buf, 2, t->rows, out);
+    fwrite(t->cid, 1, t->rows, out);
+    for(i = 0; i < t->rows; i++)
+        put32(buf + 4 * i, t->delay[i]);
+    fwrite(buf, 4, t->rows, out);
+    fwrite(t->payload, payload, t->rows, out);
+    free(buf);
+
+    ok = !ferror(out);
+    if(fclose(out) != 0 || !ok){
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv){
+    const char *output = "sink.col";
+    struct columns t;
+    uint8_t frame[RECORD_FIXED + MAX_PAYLOAD];
+    unsigned long skipped = 0, lost = 0, packets = 0;
+    int payload = 6, ticks = 128, n = 0, esc = 0, overflow = 0, c;
+    FILE *in = stdin;
+    size_t i;
+
+    while((c = getopt(argc, argv, "o:p:c:h")) != -1){
+        switch(c){
+        case 'o': output = optarg; break;
+        case 'p': payload = atoi(optarg); break;
+        case 'c': ticks = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+    if(optind < argc - 1 || payload < 0 || payload > MAX_PAYLOAD || ticks <= 0){
+        usage(argv[0]);
+        return 1;
+    }
+    if(optind < argc && strcmp(argv[optind], "-") != 0){
+        in = fopen(argv[optind], "rb");
+        if(in == NULL){
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+
+    memset(&t, 0, sizeof(t));
+    while((c = getc(in)) != EOF){
+        if(c == SLIP_END){
+            if(n > 0 || overflow){
+                if(!overflow && is_record(frame, n, payload))
+                    add_row(&t, frame, payload);
+                else
+                    skipped++;
+            }
+            n = esc = overflow = 0;
+            continue;
+        }
+        if(esc){
+            c = c == SLIP_ESC_END ? SLIP_END : c == SLIP_ESC_ESC ? SLIP_ESC : c;
+            esc = 0;
+        }else if(c == SLIP_ESC){
+            esc = 1;
+            continue;
+        }
+        if(n < (int) sizeof(frame))
+            frame[n++] = c;
+        else
+            overflow = 1;
+    }
+    if(in != stdin)
+        fclose(in);
+
+    for(i = 0; i < t.rows; i++){
+        packets += t.count[i];
+        if(i > 0)
+            lost += (uint8_t) (t.seq[i] - t.seq[i - 1] - 1);
+    }
+    if(write_columns(output, &t, payload, ticks) < 0)
+        return 1;
+
+    fprintf(stderr, "records=%zu packets=%lu lost=%lu skipped_frames=%lu\n",
+            t.rows, packets, lost, skipped);
+    return 0;
+}